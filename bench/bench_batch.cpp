@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../radix_tree.hpp"
+
+// one find() after the other against find_batch() in batches of 32 to 256
+// keys, on a tree several times larger than the last level cache.
+
+static std::string random_key()
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string key;
+
+    for (int i = 0; i < 12; i++)
+        key += digits[std::rand() % 16];
+
+    return key;
+}
+
+int main(int argc, char *argv[])
+{
+    const int count   = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    const int lookups = argc > 2 ? std::atoi(argv[2]) : 2000000;
+    const int batches[] = { 32, 64, 128, 256 };
+
+    std::srand(42);
+
+    radix_tree<std::string, int> tree;
+    std::vector<std::string> keys;
+    for (int i = 0; i < count; i++) {
+        keys.push_back(random_key());
+        tree[keys.back()] = i;
+    }
+
+    std::vector<std::string> queries;
+    for (int i = 0; i < lookups; i++)
+        queries.push_back(keys[std::rand() % keys.size()]);
+
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++)
+        sum += tree.find(queries[i])->second;
+    auto stop = std::chrono::steady_clock::now();
+    double single = std::chrono::duration<double, std::nano>(stop - start).count() / lookups;
+
+    std::printf("%zu keys\n%8s %14s %10s\n", tree.size(), "batch", "ns/lookup", "speedup");
+    std::printf("%8d %14.1f %10.2f\n", 1, single, 1.0);
+
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        std::vector<radix_tree<std::string, int>::iterator> found(batches[b]);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i + batches[b] <= lookups; i += batches[b]) {
+            tree.find_batch(std::span<const std::string>(&queries[i], batches[b]), found);
+            for (int j = 0; j < batches[b]; j++)
+                sum += found[j]->second;
+        }
+        stop = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(stop - start).count() / (lookups / batches[b] * batches[b]);
+        std::printf("%8d %14.1f %10.2f%s\n", batches[b], ns, single / ns, sum < 0 ? "!" : "");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../radix_tree.hpp"
+
+// building a tree from sorted entries: insert() per entry against
+// bulk_load() on one thread and on all cores; then the parallel build from
+// shuffled entries and parallel_for_each / parallel_remove_if.
+
+static std::string random_key()
+{
+    static const char *const hosts[] = { "www.example.com", "cdn.example.net", "api.example.org" };
+    static const char digits[] = "0123456789abcdef";
+    std::string key = hosts[std::rand() % 3];
+
+    key += "/item/";
+    for (int i = 0; i < 10; i++)
+        key += digits[std::rand() % 16];
+
+    return key;
+}
+
+template <typename F>
+static double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::srand(42);
+
+    std::vector<std::pair<std::string, int> > entries;
+    for (int i = 0; i < count; i++)
+        entries.push_back(std::make_pair(random_key(), i));
+    std::sort(entries.begin(), entries.end());
+
+    double insert = time_ms([&] {
+        radix_tree<std::string, int> tree;
+        for (size_t i = 0; i < entries.size(); i++)
+            tree.insert(entries[i]);
+    });
+
+    std::printf("%zu sorted keys\n%-22s %10s %10s\n", entries.size(), "", "ms", "speedup");
+    std::printf("%-22s %10.1f %10.2f\n", "insert", insert, 1.0);
+
+    for (unsigned threads = 1; threads <= cores; threads = threads == cores ? cores + 1 : std::min(threads * 4, cores)) {
+        size_t size = 0;
+        double bulk = time_ms([&] {
+            radix_tree<std::string, int> tree(entries.begin(), entries.end(), threads);
+            size = tree.size();
+        });
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "bulk_load, %u thr", threads);
+        std::printf("%-22s %10.1f %10.2f%s\n", name, bulk, insert / bulk, size == entries.size() ? "" : "!");
+    }
+
+    std::vector<std::pair<std::string, int> > shuffled(entries);
+    std::random_shuffle(shuffled.begin(), shuffled.end());
+
+    double unsorted = time_ms([&] {
+        radix_tree<std::string, int> tree;
+        for (size_t i = 0; i < shuffled.size(); i++)
+            tree.insert(shuffled[i]);
+    });
+    std::printf("\n%zu shuffled keys\n%-22s %10.1f %10.2f\n", shuffled.size(), "insert", unsorted, 1.0);
+
+    double build = time_ms([&] {
+        radix_tree<std::string, int> tree(shuffled.begin(), shuffled.end(), cores);
+    });
+    std::printf("%-22s %10.1f %10.2f\n", "parallel build", build, unsorted / build);
+
+    radix_tree<std::string, int> tree(entries.begin(), entries.end(), cores);
+    long sum = 0;
+    double serial = time_ms([&] {
+        for (radix_tree<std::string, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+            sum += it->second;
+    });
+    std::atomic<long> total(0);
+    double visit = time_ms([&] {
+        tree.parallel_for_each([&](std::pair<const std::string, int> &val) { total += val.second; }, cores);
+    });
+    std::printf("\n%-22s %10.1f\n%-22s %10.1f %10.2f%s\n", "iteration", serial, "parallel_for_each", visit, serial / visit, sum == total ? "" : "!");
+
+    double remove = time_ms([&] {
+        tree.parallel_remove_if([](const std::string &key) { return key[key.size() - 1] < '3'; }, cores);
+    });
+    std::printf("%-22s %10.1f\n", "parallel_remove_if", remove);
+
+    return EXIT_SUCCESS;
+}
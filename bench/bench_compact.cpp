@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../radix_tree.hpp"
+#include "../radix_tree_arena.hpp"
+
+// lookup latency of a long-lived table before and after compact(): the
+// table is aged by rounds of erases and inserts while other allocations
+// come and go around it, then looked up at random.
+
+typedef radix_tree<std::string, int> heap_tree_t;
+typedef radix_tree<std::string, int, std::less<std::string>, radix_tree_arena_allocator<std::pair<const std::string, int> > > arena_tree_t;
+
+static std::string random_key(std::mt19937 &rng)
+{
+    static const char *const hosts[] = { "www.example.com", "cdn.example.net", "api.example.org", "img.example.io" };
+    static const char digits[] = "0123456789abcdef";
+    std::string key = hosts[rng() % 4];
+
+    key += "/v1/";
+    for (int i = 0; i < 12; i++)
+        key += digits[rng() % 16];
+
+    return key;
+}
+
+template <typename F>
+static double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename Tree>
+static double lookup_ns(const Tree &tree, const std::vector<std::string> &probes)
+{
+    long sum = 0;
+    double ms = time_ms([&] {
+        for (const std::string &key : probes)
+            sum += tree.find(key)->second;
+    });
+
+    // keeps the lookups from being optimized away
+    std::printf("%s", sum < 0 ? "!" : "");
+    return ms * 1e6 / probes.size();
+}
+
+template <typename Tree>
+static void run(const char *name, Tree &tree, int count, int rounds)
+{
+    std::mt19937 rng(1);
+    std::vector<std::string> keys;
+    std::vector<std::unique_ptr<char[]> > noise;
+
+    for (int i = 0; i < count; i++) {
+        keys.push_back(random_key(rng));
+        tree[keys.back()] = i;
+    }
+
+    // age the table: replace a tenth of the keys per round while unrelated
+    // blocks of all sizes are allocated and freed between the tree's
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count / 10; i++) {
+            std::size_t victim = rng() % keys.size();
+
+            tree.erase(keys[victim]);
+            keys[victim] = random_key(rng);
+            tree[keys[victim]] = i;
+
+            noise.emplace_back(new char[16 + rng() % 200]);
+            if (noise.size() > static_cast<std::size_t>(count / 4)) {
+                std::swap(noise[rng() % noise.size()], noise.back());
+                noise.pop_back();
+            }
+        }
+    }
+
+    std::vector<std::string> probes;
+    for (int i = 0; i < 2000000; i++)
+        probes.push_back(keys[rng() % keys.size()]);
+
+    double before  = lookup_ns(tree, probes);
+    double compact = time_ms([&] { tree.compact(); });
+    double after   = lookup_ns(tree, probes);
+
+    std::printf("%-10s %12.0f %12.0f %12.1f %9.2f\n", name, before, after, compact, before / after);
+}
+
+int main(int argc, char *argv[])
+{
+    const int count  = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::printf("%d keys, %d rounds of churn\n%-10s %12s %12s %12s %9s\n", count, rounds, "", "ns before", "ns after", "compact ms", "speedup");
+
+    {
+        heap_tree_t tree;
+        run("heap", tree, count, rounds);
+    }
+    {
+        radix_tree_arena arena;
+        arena_tree_t tree(arena);
+        run("arena", tree, count, rounds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_radix_tree.hpp"
+#include "../radix_tree.hpp"
+
+// longest_match throughput from many reader threads while one writer keeps
+// inserting and erasing routes: concurrent_radix_tree against radix_tree
+// behind a reader/writer lock.
+
+static std::vector<std::string> make_routes(int count)
+{
+    std::vector<std::string> routes;
+
+    std::srand(42);
+    for (int i = 0; i < count; i++) {
+        std::string route;
+        int segments = 1 + std::rand() % 4;
+        for (int s = 0; s < segments; s++)
+            route += "/" + std::to_string(std::rand() % 64);
+        routes.push_back(route);
+    }
+
+    return routes;
+}
+
+struct locked_tree {
+    radix_tree<std::string, int> tree;
+    mutable std::shared_mutex    mutex;
+
+    bool lookup(const std::string &key) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return tree.longest_match(key) != tree.cend();
+    }
+    void insert(const std::string &key, int value) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        tree.insert_or_assign(key, value);
+    }
+    void erase(const std::string &key) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        tree.erase(key);
+    }
+};
+
+struct lock_free_tree {
+    concurrent_radix_tree<std::string, int> tree;
+
+    bool lookup(const std::string &key) const { return tree.longest_match(key).has_value(); }
+    void insert(const std::string &key, int value) { tree.insert_or_assign(key, value); }
+    void erase(const std::string &key) { tree.erase(key); }
+};
+
+template <typename Tree>
+static double run(int readers, int millis, const std::vector<std::string> &routes, const std::vector<std::string> &queries)
+{
+    Tree tree;
+    for (size_t i = 0; i < routes.size(); i++)
+        tree.insert(routes[i], static_cast<int>(i));
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> lookups(0);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < readers; t++) {
+        threads.push_back(std::thread([&, t]() {
+            long count = 0;
+            long hits  = 0;
+            for (size_t i = t; ! stop.load(std::memory_order_relaxed); i++, count++)
+                hits += tree.lookup(queries[i % queries.size()]);
+            lookups += count + (hits < 0);
+        }));
+    }
+
+    std::thread writer([&]() {
+        for (size_t i = 0; ! stop.load(std::memory_order_relaxed); i++) {
+            const std::string &route = routes[i % routes.size()];
+            tree.erase(route);
+            tree.insert(route, static_cast<int>(i));
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop = true;
+    writer.join();
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    return lookups.load() / (millis / 1000.0) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const int readers[] = { 1, 2, 4, 8, 16 };
+    const int millis    = argc > 1 ? std::atoi(argv[1]) : 500;
+
+    std::vector<std::string> routes = make_routes(50000);
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < routes.size(); i++)
+        queries.push_back(routes[(i * 7919) % routes.size()] + "/" + std::to_string(i % 100));
+
+    std::printf("%8s %18s %18s\n", "readers", "rwlock Mlookup/s", "epoch Mlookup/s");
+
+    for (size_t r = 0; r < sizeof(readers) / sizeof(readers[0]); r++) {
+        double locked    = run<locked_tree>(readers[r], millis, routes, queries);
+        double lock_free = run<lock_free_tree>(readers[r], millis, routes, queries);
+        std::printf("%8d %18.2f %18.2f\n", readers[r], locked, lock_free);
+    }
+
+    return EXIT_SUCCESS;
+}
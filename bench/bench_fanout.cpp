@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../radix_tree.hpp"
+
+// lookup time versus fanout: every level of the tree has `fanout` children,
+// so the cost of one descent step dominates the measured time.
+
+static std::vector<std::string> make_keys(int fanout, int levels)
+{
+    std::vector<std::string> keys(1);
+
+    for (int level = 0; level < levels; level++) {
+        std::vector<std::string> next;
+        for (size_t i = 0; i < keys.size(); i++) {
+            for (int c = 0; c < fanout; c++) {
+                next.push_back(keys[i] + static_cast<char>(' ' + c) + "/x");
+            }
+        }
+        keys.swap(next);
+    }
+
+    return keys;
+}
+
+int main(int argc, char *argv[])
+{
+    const int fanouts[] = { 2, 4, 8, 16, 32, 64, 128, 200 };
+    const int lookups   = argc > 1 ? std::atoi(argv[1]) : 2000000;
+
+    std::printf("%8s %10s %14s\n", "fanout", "keys", "ns/lookup");
+
+    for (size_t f = 0; f < sizeof(fanouts) / sizeof(fanouts[0]); f++) {
+        int fanout = fanouts[f];
+        int levels = fanout <= 16 ? 3 : 2;
+
+        std::vector<std::string> keys = make_keys(fanout, levels);
+        radix_tree<std::string, int> tree;
+
+        for (size_t i = 0; i < keys.size(); i++)
+            tree[keys[i]] = static_cast<int>(i);
+
+        std::srand(42);
+        std::vector<size_t> order(lookups);
+        for (int i = 0; i < lookups; i++)
+            order[i] = std::rand() % keys.size();
+
+        long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++)
+            sum += tree.find(keys[order[i]])->second;
+        auto stop = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(stop - start).count() / lookups;
+        std::printf("%8d %10zu %14.1f%s\n", fanout, keys.size(), ns, sum < 0 ? "!" : "");
+    }
+
+    return EXIT_SUCCESS;
+}
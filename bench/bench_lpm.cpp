@@ -0,0 +1,94 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../patricia_tree.hpp"
+#include "../radix_tree_lpm.hpp"
+
+// IPv4 longest-prefix-match lookups on a synthetic full table: the patricia
+// rule set against the DIR-24-8 and Poptrie tables compiled from it, plus the
+// cost of an incremental update of each compiled table.
+
+struct route {
+    std::uint32_t addr;
+    int           len;
+};
+
+// roughly the length mix of an Internet table, most routes /24
+static std::vector<route> make_routes(int count)
+{
+    static const int lengths[] = { 8, 12, 16, 16, 19, 20, 21, 22, 22, 23, 24, 24, 24, 24, 24, 24, 28, 32 };
+    std::vector<route> routes;
+
+    std::srand(42);
+    for (int i = 0; i < count; i++) {
+        int           len  = lengths[std::rand() % (sizeof(lengths) / sizeof(lengths[0]))];
+        std::uint32_t addr = (std::uint32_t(std::rand()) << 16) ^ std::uint32_t(std::rand());
+        routes.push_back(route{ addr & radix_bits<std::uint32_t>::mask(len), len });
+    }
+
+    return routes;
+}
+
+template <typename Table>
+static double lookup_ns(const Table &table, const std::vector<std::uint32_t> &queries)
+{
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries.size(); i++) {
+        const int *value = table.longest_match(queries[i]);
+        sum += value != NULL ? *value : 0;
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    if (sum == -1)
+        std::printf("!");
+    return std::chrono::duration<double, std::nano>(stop - start).count() / queries.size();
+}
+
+template <typename Table>
+static double update_us(Table &table, const std::vector<route> &routes)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 1000; i++) {
+        const route &r = routes[(i * 7919) % routes.size()];
+        table.erase(r.addr, r.len);
+        table.insert(r.addr, r.len, static_cast<int>(i));
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(stop - start).count() / 2000;
+}
+
+int main(int argc, char *argv[])
+{
+    const int count   = argc > 1 ? std::atoi(argv[1]) : 500000;
+    const int lookups = argc > 2 ? std::atoi(argv[2]) : 5000000;
+
+    std::vector<route> routes = make_routes(count);
+
+    ipv4_radix_tree<int> rules;
+    dir24_8_lpm<int>     dir;
+    poptrie_lpm<int>     poptrie;
+
+    for (size_t i = 0; i < routes.size(); i++) {
+        rules.insert(routes[i].addr, routes[i].len, static_cast<int>(i));
+        dir.add(routes[i].addr, routes[i].len, static_cast<int>(i));
+        poptrie.add(routes[i].addr, routes[i].len, static_cast<int>(i));
+    }
+    dir.rebuild();
+    poptrie.rebuild();
+
+    std::vector<std::uint32_t> queries(lookups);
+    for (int i = 0; i < lookups; i++)
+        queries[i] = (std::uint32_t(std::rand()) << 16) ^ std::uint32_t(std::rand());
+
+    std::printf("%zu routes, poptrie %zu nodes %zu leaves\n", rules.size(), poptrie.node_count(), poptrie.leaf_count());
+    std::printf("%10s %14s %14s\n", "table", "ns/lookup", "us/update");
+    std::printf("%10s %14.1f %14s\n", "patricia", lookup_ns(rules, queries), "-");
+    std::printf("%10s %14.1f %14.1f\n", "dir24_8", lookup_ns(dir, queries), update_us(dir, routes));
+    std::printf("%10s %14.1f %14.1f\n", "poptrie", lookup_ns(poptrie, queries), update_us(poptrie, routes));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,588 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <malloc.h>
+
+#include <benchmark/benchmark.h>
+
+#include "../radix_tree.hpp"
+
+// radix_tree against std::map and std::unordered_map on several key
+// corpora. Every benchmark takes { corpus, number of keys } as arguments;
+// the insert benchmarks also report heap bytes per key, keys included.
+
+enum corpus_kind { urls, paths, random_strings, numeric, corpus_count };
+
+static const char *const corpus_names[] = { "urls", "paths", "random", "numeric" };
+
+static std::string url(std::mt19937 &rng)
+{
+    static const char *const hosts[] = { "www.example.com", "cdn.example.net", "api.example.org", "static.example.io" };
+    static const char *const sections[] = { "/products/", "/users/", "/static/img/", "/v2/orders/", "/blog/2024/" };
+    std::string key = "https://";
+
+    key += hosts[rng() % 4];
+    key += sections[rng() % 5];
+    key += std::to_string(rng() % 1000000);
+    if (rng() % 2)
+        key += "?ref=" + std::to_string(rng() % 100);
+
+    return key;
+}
+
+static std::string path(std::mt19937 &rng)
+{
+    static const char *const dirs[] = { "usr", "lib", "share", "local", "include", "src", "home", "etc", "var", "log" };
+    std::string key;
+    int depth = 2 + rng() % 5;
+
+    for (int i = 0; i < depth; i++) {
+        key += '/';
+        key += dirs[rng() % 10];
+        if (i > 1)
+            key += std::to_string(rng() % 50);
+    }
+    key += "/file" + std::to_string(rng() % 1000) + ".txt";
+
+    return key;
+}
+
+static std::string random_string(std::mt19937 &rng)
+{
+    std::string key;
+    int len = 8 + rng() % 24;
+
+    for (int i = 0; i < len; i++)
+        key += static_cast<char>('!' + rng() % 94);
+
+    return key;
+}
+
+// consecutive ids with some gaps, as handed out by a sequence
+static std::string dense_number(std::mt19937 &rng, int i)
+{
+    return std::to_string(100000000 + i * 3 + rng() % 3);
+}
+
+static const std::vector<std::string>& corpus(int kind, int count)
+{
+    static std::map<std::pair<int, int>, std::vector<std::string> > cache;
+    std::vector<std::string> &keys = cache[std::make_pair(kind, count)];
+
+    if (! keys.empty())
+        return keys;
+
+    std::mt19937 rng(42);
+    for (int i = 0; static_cast<int>(keys.size()) < count; i++) {
+        switch (kind) {
+        case urls:           keys.push_back(url(rng)); break;
+        case paths:          keys.push_back(path(rng)); break;
+        case random_strings: keys.push_back(random_string(rng)); break;
+        default:             keys.push_back(dense_number(rng, i)); break;
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    while (static_cast<int>(keys.size()) < count)
+        keys.push_back(keys.back() + "~");
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    return keys;
+}
+
+static std::size_t heap_in_use()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+typedef radix_tree<std::string, int>              radix_t;
+typedef std::map<std::string, int>                map_t;
+typedef std::unordered_map<std::string, int>      hash_t;
+
+// operations that differ between the containers
+
+static std::size_t remove_if(radix_t &c, bool (*pred)(const std::string&))
+{
+    return c.remove_if(pred);
+}
+
+template <typename C>
+static std::size_t remove_if(C &c, bool (*pred)(const std::string&))
+{
+    return std::erase_if(c, [pred](const typename C::value_type &val) { return pred(val.first); });
+}
+
+static bool longest_match(const radix_t &c, const std::string &key)
+{
+    return c.longest_match(key) != c.end();
+}
+
+// the hash and tree baselines probe every prefix of the key, longest first
+template <typename C>
+static bool longest_match(const C &c, const std::string &key)
+{
+    for (std::size_t len = key.size() + 1; len-- > 0; ) {
+        if (c.find(key.substr(0, len)) != c.end())
+            return true;
+    }
+    return false;
+}
+
+static std::size_t prefix_count(const radix_t &c, const std::string &prefix)
+{
+    return static_cast<std::size_t>(std::ranges::distance(c.prefix_range(prefix)));
+}
+
+static std::size_t prefix_count(const map_t &c, const std::string &prefix)
+{
+    std::size_t count = 0;
+    for (map_t::const_iterator it = c.lower_bound(prefix); it != c.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        count++;
+    return count;
+}
+
+static bool expire(const std::string &key)
+{
+    return key[key.size() - 1] % 5 == 0;
+}
+
+template <typename C>
+static void fill(C &c, const std::vector<std::string> &keys)
+{
+    for (std::size_t i = 0; i < keys.size(); i++)
+        c.insert(typename C::value_type(keys[i], static_cast<int>(i)));
+}
+
+static void describe(benchmark::State &state)
+{
+    state.SetLabel(corpus_names[state.range(0)]);
+}
+
+template <typename C>
+static void BM_insert(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    double bytes = 0;
+
+    for (auto _ : state) {
+        std::size_t before = heap_in_use();
+        C c;
+        fill(c, keys);
+        bytes = static_cast<double>(heap_in_use() - before);
+        benchmark::DoNotOptimize(c);
+        state.PauseTiming();
+        c.clear();
+        state.ResumeTiming();
+    }
+
+    state.counters["bytes_per_key"] = bytes / keys.size();
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    describe(state);
+}
+
+template <typename C>
+static void BM_find(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    C c;
+    fill(c, keys);
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(c.find(keys[i]));
+        if (++i == keys.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    describe(state);
+}
+
+template <typename C>
+static void BM_erase(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        C c;
+        fill(c, keys);
+        state.ResumeTiming();
+        for (std::size_t i = 0; i < keys.size(); i++)
+            c.erase(keys[i]);
+        benchmark::DoNotOptimize(c);
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    describe(state);
+}
+
+template <typename C>
+static void BM_subscript(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+
+    for (auto _ : state) {
+        C c;
+        // the first round inserts, the second updates
+        for (int round = 0; round < 2; round++) {
+            for (std::size_t i = 0; i < keys.size(); i++)
+                c[keys[i]]++;
+        }
+        benchmark::DoNotOptimize(c);
+        state.PauseTiming();
+        c.clear();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size() * 2);
+    describe(state);
+}
+
+template <typename C>
+static void BM_iterate(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    C c;
+    fill(c, keys);
+
+    for (auto _ : state) {
+        long sum = 0;
+        for (typename C::iterator it = c.begin(); it != c.end(); ++it)
+            sum += it->second;
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    describe(state);
+}
+
+template <typename C>
+static void BM_remove_if(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        C c;
+        fill(c, keys);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(remove_if(c, expire));
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    describe(state);
+}
+
+// queries extend a stored key, which is then the longest match
+template <typename C>
+static void BM_longest_match(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    C c;
+    fill(c, keys);
+
+    std::vector<std::string> queries;
+    for (std::size_t i = 0; i < keys.size(); i++)
+        queries.push_back(keys[i] + "/extra/suffix");
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(longest_match(c, queries[i]));
+        if (++i == queries.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    describe(state);
+}
+
+// prefixes cut from stored keys at two thirds of their length
+template <typename C>
+static void BM_prefix_match(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    C c;
+    fill(c, keys);
+
+    std::vector<std::string> prefixes;
+    for (std::size_t i = 0; i < keys.size(); i++)
+        prefixes.push_back(keys[i].substr(0, keys[i].size() * 2 / 3));
+
+    std::size_t i = 0, found = 0;
+    for (auto _ : state) {
+        found += prefix_count(c, prefixes[i]);
+        if (++i == prefixes.size())
+            i = 0;
+    }
+
+    state.counters["matches"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    describe(state);
+}
+
+static void BM_prefix_match_vector(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    radix_t c;
+    fill(c, keys);
+
+    std::vector<radix_t::iterator> found;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        c.prefix_match(keys[i].substr(0, keys[i].size() * 2 / 3), found);
+        benchmark::DoNotOptimize(found.data());
+        if (++i == keys.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    describe(state);
+}
+
+static void BM_greedy_match(benchmark::State &state)
+{
+    const std::vector<std::string> &keys = corpus(state.range(0), state.range(1));
+    radix_t c;
+    fill(c, keys);
+
+    std::vector<radix_t::iterator> found;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        c.greedy_match(keys[i] + "#", found);
+        benchmark::DoNotOptimize(found.data());
+        if (++i == keys.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    describe(state);
+}
+
+// IPv4 routes keyed by the rtentry of examples/example2.cpp: one element
+// per address bit
+class rtentry {
+public:
+    in_addr_t addr;
+    int       prefix_len;
+
+    rtentry() : addr(0), prefix_len(0) { }
+    rtentry(in_addr_t a, int len) : addr(a), prefix_len(len) { }
+
+    in_addr_t operator[] (int n) const {
+        if (addr & (0x80000000 >> n))
+            return 1;
+        else
+            return 0;
+    }
+
+    bool operator== (const rtentry &rhs) const {
+        return prefix_len == rhs.prefix_len && addr == rhs.addr;
+    }
+
+    bool operator< (const rtentry &rhs) const {
+        if (addr == rhs.addr)
+            return prefix_len < rhs.prefix_len;
+        else
+            return addr < rhs.addr;
+    }
+};
+
+rtentry radix_substr(const rtentry &entry, int begin, int num)
+{
+    rtentry   ret;
+    in_addr_t mask;
+
+    if (num == 32)
+        mask = 0;
+    else
+        mask = 1 << num;
+
+    mask  -= 1;
+    mask <<= 32 - num - begin;
+
+    ret.addr       = (entry.addr & mask) << begin;
+    ret.prefix_len = num;
+
+    return ret;
+}
+
+rtentry radix_join(const rtentry &entry1, const rtentry &entry2)
+{
+    rtentry ret;
+
+    ret.addr        = entry1.addr;
+    ret.addr       |= entry2.addr >> entry1.prefix_len;
+    ret.prefix_len  = entry1.prefix_len + entry2.prefix_len;
+
+    return ret;
+}
+
+int radix_length(const rtentry &entry)
+{
+    return entry.prefix_len;
+}
+
+typedef radix_tree<rtentry, int> rtable_t;
+typedef std::map<rtentry, int>   rtmap_t;
+
+// roughly the length mix of an Internet table, most routes /24
+static const std::vector<rtentry>& routes(int count)
+{
+    static std::map<int, std::vector<rtentry> > cache;
+    std::vector<rtentry> &result = cache[count];
+
+    if (! result.empty())
+        return result;
+
+    static const int lengths[] = { 8, 12, 16, 16, 19, 20, 21, 22, 22, 23, 24, 24, 24, 24, 24, 24, 28, 32 };
+    std::mt19937 rng(42);
+    rtmap_t unique;
+
+    while (static_cast<int>(unique.size()) < count) {
+        int       len  = lengths[rng() % (sizeof(lengths) / sizeof(lengths[0]))];
+        in_addr_t mask = len == 0 ? 0 : ~in_addr_t(0) << (32 - len);
+        unique[rtentry(static_cast<in_addr_t>(rng()) & mask, len)] = 0;
+    }
+    for (rtmap_t::iterator it = unique.begin(); it != unique.end(); ++it)
+        result.push_back(it->first);
+    std::shuffle(result.begin(), result.end(), rng);
+
+    return result;
+}
+
+template <typename C>
+static void BM_rt_insert(benchmark::State &state)
+{
+    const std::vector<rtentry> &keys = routes(state.range(0));
+    double bytes = 0;
+
+    for (auto _ : state) {
+        std::size_t before = heap_in_use();
+        C c;
+        for (std::size_t i = 0; i < keys.size(); i++)
+            c[keys[i]] = static_cast<int>(i);
+        bytes = static_cast<double>(heap_in_use() - before);
+        benchmark::DoNotOptimize(c);
+        state.PauseTiming();
+        c.clear();
+        state.ResumeTiming();
+    }
+
+    state.counters["bytes_per_key"] = bytes / keys.size();
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename C>
+static void BM_rt_find(benchmark::State &state)
+{
+    const std::vector<rtentry> &keys = routes(state.range(0));
+    C c;
+    for (std::size_t i = 0; i < keys.size(); i++)
+        c[keys[i]] = static_cast<int>(i);
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(c.find(keys[i]));
+        if (++i == keys.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// the std::map baseline probes the 33 prefixes of the address
+static bool rt_longest_match(const rtable_t &c, const rtentry &addr)
+{
+    return c.longest_match(addr) != c.end();
+}
+
+static bool rt_longest_match(const rtmap_t &c, const rtentry &addr)
+{
+    for (int len = 32; len >= 0; len--) {
+        in_addr_t mask = len == 0 ? 0 : ~in_addr_t(0) << (32 - len);
+        if (c.find(rtentry(addr.addr & mask, len)) != c.end())
+            return true;
+    }
+    return false;
+}
+
+template <typename C>
+static void BM_rt_longest_match(benchmark::State &state)
+{
+    const std::vector<rtentry> &keys = routes(state.range(0));
+    C c;
+    for (std::size_t i = 0; i < keys.size(); i++)
+        c[keys[i]] = static_cast<int>(i);
+
+    std::mt19937 rng(7);
+    std::vector<rtentry> queries;
+    for (std::size_t i = 0; i < keys.size(); i++)
+        queries.push_back(rtentry(static_cast<in_addr_t>(rng()), 32));
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rt_longest_match(c, queries[i]));
+        if (++i == queries.size())
+            i = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void string_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({ "corpus", "keys" });
+    for (int kind = 0; kind < corpus_count; kind++) {
+        b->Args({ kind, 1 << 12 });
+        b->Args({ kind, 1 << 18 });
+    }
+}
+
+static void route_args(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({ "routes" })->Arg(1 << 12)->Arg(1 << 18);
+}
+
+BENCHMARK_TEMPLATE(BM_insert, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_insert, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_insert, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_find, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_find, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_find, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_erase, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_erase, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_erase, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_subscript, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_subscript, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_subscript, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_iterate, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_iterate, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_iterate, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_remove_if, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_remove_if, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_remove_if, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_longest_match, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_longest_match, map_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_longest_match, hash_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_prefix_match, radix_t)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_prefix_match, map_t)->Apply(string_args);
+BENCHMARK(BM_prefix_match_vector)->Apply(string_args);
+BENCHMARK(BM_greedy_match)->Apply(string_args);
+BENCHMARK_TEMPLATE(BM_rt_insert, rtable_t)->Apply(route_args);
+BENCHMARK_TEMPLATE(BM_rt_insert, rtmap_t)->Apply(route_args);
+BENCHMARK_TEMPLATE(BM_rt_find, rtable_t)->Apply(route_args);
+BENCHMARK_TEMPLATE(BM_rt_find, rtmap_t)->Apply(route_args);
+BENCHMARK_TEMPLATE(BM_rt_longest_match, rtable_t)->Apply(route_args);
+BENCHMARK_TEMPLATE(BM_rt_longest_match, rtmap_t)->Apply(route_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,595 @@
+#ifndef CONCURRENT_RADIX_TREE_HPP
+#define CONCURRENT_RADIX_TREE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "radix_tree.hpp"
+#include "radix_tree_epoch.hpp"
+
+/*
+ * Radix tree for read-mostly use from many threads.
+ *
+ * Readers (find, longest_match, prefix_match) take no lock: they announce an
+ * epoch, load the root and walk nodes that are never modified once
+ * published. Writers (insert, insert_or_assign, erase) are serialised by a
+ * mutex; a write copies the nodes on the path to the change, publishes the
+ * new root with one atomic store and retires the replaced nodes, which are
+ * freed once no reader can still see them (see radix_tree_epoch).
+ *
+ * Lookups return copies of the values, since a reference would outlive the
+ * read section that keeps the node alive.
+ *
+ * Since a write never modifies a published node, the tree after a write
+ * shares every node off the changed path with the tree before it. Nodes are
+ * reference counted by their parents, and snapshot() pins the current root
+ * in O(1): the view it returns keeps seeing the tree as it was, however
+ * much is written afterwards, and needs no epoch to read it. The nodes
+ * only it still holds are freed when the view is destroyed. Views must not
+ * outlive the tree.
+ */
+template <typename K, typename T>
+class concurrent_radix_tree {
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef std::size_t           size_type;
+    typedef typename radix_key_traits<K>::view_type key_view;
+
+    concurrent_radix_tree() : m_root(NULL), m_size(0), m_views(0) { }
+    ~concurrent_radix_tree();
+
+    size_type size() const { return m_size.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+
+    std::optional<T> find(const K &key) const { return find(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    std::optional<T> find(const KeyLike &key) const;
+    std::optional<value_type> longest_match(const K &key) const { return longest_match(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    std::optional<value_type> longest_match(const KeyLike &key) const;
+    void prefix_match(const K &key, std::vector<value_type> &vec) const { prefix_match(key_view(key), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void prefix_match(const KeyLike &key, std::vector<value_type> &vec) const;
+
+    bool insert(const value_type &val) { return write(val, false); }
+    bool insert_or_assign(const K &key, const T &value) { return write(value_type(key, value), true); }
+    bool erase(const K &key);
+
+    // nodes unlinked by writers that readers may still be walking; waits
+    // for the writer, whose list it is
+    size_type pending_reclaim() const;
+
+    class view;
+    view snapshot() const;
+
+private:
+    typedef radix_element_t<K> element_type;
+
+    struct node;
+    typedef std::vector<std::pair<element_type, node*> > children_type; // sorted by element
+
+    struct node {
+        node(const K &key, int depth) : m_key(key), m_depth(depth), m_refs(0) { }
+
+        K m_key;   // label of the edge from the parent
+        int m_depth;
+        int m_refs;  // parents, the root and views; written under the write mutex
+        std::optional<value_type> m_value;
+        children_type m_children;
+
+        node* child(const element_type &elem) const;
+        int end() const { return m_depth + radix_length(m_key); }
+    };
+
+    std::atomic<node*>        m_root;
+    std::atomic<size_type>    m_size;
+    mutable std::mutex        m_write_mutex;
+    mutable radix_tree_epoch  m_epoch;
+    mutable size_type         m_views;
+
+    concurrent_radix_tree(const concurrent_radix_tree&); // delete
+    concurrent_radix_tree& operator=(const concurrent_radix_tree&); // delete
+
+    bool write(const value_type &val, bool assign);
+    node* insert(node *n, const key_view &key, const value_type &val, bool assign, bool &inserted);
+    node* erase(node *n, const key_view &key, bool is_root);
+    node* copy(const node *n);
+    node* merge(node *n, node *child);
+    void release(node *n) const;
+    void set_child(children_type &children, node *child) const;
+    void remove_child(children_type &children, const element_type &elem) const;
+
+    static std::optional<T> find(const node *n, const key_view &key);
+    static std::optional<value_type> longest_match(const node *n, const key_view &key);
+    static void prefix_match(const node *n, const key_view &key, std::vector<value_type> &vec);
+    static void collect(const node *n, std::vector<value_type> &vec);
+    static void free_node(void *p);
+};
+
+// a read-only, frozen copy of the tree as it was when snapshot() was called
+template <typename K, typename T>
+class concurrent_radix_tree<K, T>::view {
+public:
+    view(view &&other) noexcept : m_tree(other.m_tree), m_root(other.m_root), m_size(other.m_size) { other.m_tree = NULL; }
+    // drops the snapshot held so far before taking over other's
+    view& operator=(view &&other) noexcept;
+    ~view();
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    std::optional<T> find(const K &key) const { return find(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    std::optional<T> find(const KeyLike &key) const { return concurrent_radix_tree::find(m_root, key_view(key)); }
+    std::optional<value_type> longest_match(const K &key) const { return longest_match(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    std::optional<value_type> longest_match(const KeyLike &key) const { return concurrent_radix_tree::longest_match(m_root, key_view(key)); }
+    void prefix_match(const K &key, std::vector<value_type> &vec) const { prefix_match(key_view(key), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void prefix_match(const KeyLike &key, std::vector<value_type> &vec) const { concurrent_radix_tree::prefix_match(m_root, key_view(key), vec); }
+
+private:
+    friend class concurrent_radix_tree;
+
+    view(const concurrent_radix_tree *tree, node *root, size_type size) : m_tree(tree), m_root(root), m_size(size) { }
+    view(const view&); // delete
+    view& operator=(const view&); // delete
+
+    void release();
+
+    const concurrent_radix_tree *m_tree;
+    node *m_root;
+    size_type m_size;
+};
+
+template <typename K, typename T>
+concurrent_radix_tree<K, T>::~concurrent_radix_tree()
+{
+    assert(m_views == 0);
+
+    m_epoch.reclaim_all();
+
+    node *root = m_root.load(std::memory_order_relaxed);
+    if (root != NULL && --root->m_refs == 0)
+        free_node(root);
+}
+
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::view& concurrent_radix_tree<K, T>::view::operator=(view &&other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    release();
+    m_tree = other.m_tree;
+    m_root = other.m_root;
+    m_size = other.m_size;
+    other.m_tree = NULL;
+
+    return *this;
+}
+
+template <typename K, typename T>
+concurrent_radix_tree<K, T>::view::~view()
+{
+    release();
+}
+
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::view::release()
+{
+    if (m_tree == NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_tree->m_write_mutex);
+
+    if (m_root != NULL)
+        m_tree->release(m_root);
+    m_tree->m_views--;
+
+    m_tree->m_epoch.advance();
+    m_tree->m_epoch.reclaim();
+}
+
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::size_type concurrent_radix_tree<K, T>::pending_reclaim() const
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+
+    return m_epoch.pending();
+}
+
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::view concurrent_radix_tree<K, T>::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+
+    node *root = m_root.load(std::memory_order_relaxed);
+    if (root != NULL)
+        root->m_refs++;
+    m_views++;
+
+    return view(this, root, m_size.load(std::memory_order_relaxed));
+}
+
+// drops a reference; the last one retires the node, since readers of the
+// tree may still be walking it
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::release(node *n) const
+{
+    if (--n->m_refs == 0)
+        m_epoch.retire(n, &free_node);
+}
+
+// no reader can reach the node any more, nor a child only it referenced
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::free_node(void *p)
+{
+    node *n = static_cast<node*>(p);
+
+    for (std::size_t i = 0; i < n->m_children.size(); i++) {
+        node *child = n->m_children[i].second;
+        if (--child->m_refs == 0)
+            free_node(child);
+    }
+    delete n;
+}
+
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::node* concurrent_radix_tree<K, T>::node::child(const element_type &elem) const
+{
+    auto it = std::lower_bound(m_children.begin(), m_children.end(), elem,
+                               [](const std::pair<element_type, node*> &entry, const element_type &e) { return entry.first < e; });
+
+    if (it == m_children.end() || ! (it->first == elem))
+        return NULL;
+
+    return it->second;
+}
+
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::set_child(children_type &children, node *child) const
+{
+    const element_type &elem = child->m_key[0];
+    auto it = std::lower_bound(children.begin(), children.end(), elem,
+                               [](const std::pair<element_type, node*> &entry, const element_type &e) { return entry.first < e; });
+
+    child->m_refs++;
+    if (it != children.end() && it->first == elem) {
+        release(it->second);
+        it->second = child;
+    } else {
+        children.insert(it, std::pair<element_type, node*>(elem, child));
+    }
+}
+
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::remove_child(children_type &children, const element_type &elem) const
+{
+    auto it = std::lower_bound(children.begin(), children.end(), elem,
+                               [](const std::pair<element_type, node*> &entry, const element_type &e) { return entry.first < e; });
+
+    if (it != children.end() && it->first == elem) {
+        release(it->second);
+        children.erase(it);
+    }
+}
+
+template <typename K, typename T>
+template <typename KeyLike, typename>
+std::optional<T> concurrent_radix_tree<K, T>::find(const KeyLike &key) const
+{
+    radix_tree_epoch::guard guard(m_epoch);
+    // seq_cst keeps this load after the epoch announcement
+    return find(m_root.load(std::memory_order_seq_cst), key_view(key));
+}
+
+template <typename K, typename T>
+template <typename KeyLike, typename>
+std::optional<typename concurrent_radix_tree<K, T>::value_type> concurrent_radix_tree<K, T>::longest_match(const KeyLike &key) const
+{
+    radix_tree_epoch::guard guard(m_epoch);
+    return longest_match(m_root.load(std::memory_order_seq_cst), key_view(key));
+}
+
+template <typename K, typename T>
+template <typename KeyLike, typename>
+void concurrent_radix_tree<K, T>::prefix_match(const KeyLike &key, std::vector<value_type> &vec) const
+{
+    radix_tree_epoch::guard guard(m_epoch);
+    prefix_match(m_root.load(std::memory_order_seq_cst), key_view(key), vec);
+}
+
+template <typename K, typename T>
+std::optional<T> concurrent_radix_tree<K, T>::find(const node *n, const key_view &key)
+{
+    int len = radix_length(key);
+
+    while (n != NULL) {
+        int depth = n->end();
+        if (depth == len)
+            return n->m_value ? std::optional<T>(n->m_value->second) : std::nullopt;
+
+        n = n->child(key[depth]);
+        if (n == NULL)
+            break;
+
+        int len_node = radix_length(n->m_key);
+        if (len_node > len - depth || ! radix_match(key, depth, n->m_key, len_node))
+            break;
+    }
+
+    return std::nullopt;
+}
+
+template <typename K, typename T>
+std::optional<typename concurrent_radix_tree<K, T>::value_type> concurrent_radix_tree<K, T>::longest_match(const node *n, const key_view &key)
+{
+    int len = radix_length(key);
+    const node *best = NULL;
+
+    while (n != NULL) {
+        if (n->m_value)
+            best = n;
+
+        int depth = n->end();
+        if (depth == len)
+            break;
+
+        n = n->child(key[depth]);
+        if (n == NULL)
+            break;
+
+        int len_node = radix_length(n->m_key);
+        if (len_node > len - depth || ! radix_match(key, depth, n->m_key, len_node))
+            break;
+    }
+
+    return best == NULL ? std::nullopt : std::optional<value_type>(*best->m_value);
+}
+
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::prefix_match(const node *n, const key_view &key, std::vector<value_type> &vec)
+{
+    vec.clear();
+
+    int len = radix_length(key);
+
+    while (n != NULL) {
+        int depth = n->end();
+        if (depth >= len) {
+            collect(n, vec);
+            return;
+        }
+
+        n = n->child(key[depth]);
+        if (n == NULL)
+            return;
+
+        // the rest of the key may end inside the label
+        int len_node = std::min(radix_length(n->m_key), len - depth);
+        if (! radix_match(key, depth, n->m_key, len_node))
+            return;
+    }
+}
+
+template <typename K, typename T>
+void concurrent_radix_tree<K, T>::collect(const node *n, std::vector<value_type> &vec)
+{
+    if (n->m_value)
+        vec.push_back(*n->m_value);
+
+    for (std::size_t i = 0; i < n->m_children.size(); i++)
+        collect(n->m_children[i].second, vec);
+}
+
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::node* concurrent_radix_tree<K, T>::copy(const node *n)
+{
+    node *c = new node(n->m_key, n->m_depth);
+
+    if (n->m_value)
+        c->m_value.emplace(*n->m_value);
+    c->m_children = n->m_children;
+    for (std::size_t i = 0; i < c->m_children.size(); i++)
+        c->m_children[i].second->m_refs++;
+
+    return c;
+}
+
+template <typename K, typename T>
+bool concurrent_radix_tree<K, T>::write(const value_type &val, bool assign)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+
+    node *root = m_root.load(std::memory_order_relaxed);
+    if (root == NULL) {
+        root = new node(radix_substr(val.first, 0, 0), 0);
+        root->m_refs++;
+        m_root.store(root, std::memory_order_seq_cst);
+    }
+
+    bool inserted = false;
+    node *updated = insert(root, key_view(val.first), val, assign, inserted);
+
+    if (updated != root) {
+        updated->m_refs++;
+        m_root.store(updated, std::memory_order_seq_cst);
+        release(root);
+    }
+
+    if (inserted)
+        m_size.fetch_add(1, std::memory_order_relaxed);
+
+    m_epoch.advance();
+    m_epoch.reclaim();
+
+    return inserted;
+}
+
+// returns n itself if nothing changed, otherwise a new node replacing it;
+// every node on the changed path is copied, and the old one is released by
+// whoever replaces the link to it
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::node* concurrent_radix_tree<K, T>::insert(node *n, const key_view &key, const value_type &val, bool assign, bool &inserted)
+{
+    int depth = n->end();
+    int len   = radix_length(key);
+
+    if (depth == len) {
+        if (n->m_value && ! assign)
+            return n;
+
+        inserted = ! n->m_value;
+
+        node *c = copy(n);
+        c->m_value.reset();
+        c->m_value.emplace(val);
+        return c;
+    }
+
+    node *child = n->child(key[depth]);
+    node *updated;
+
+    if (child == NULL) {
+        updated = new node(radix_substr(val.first, depth, len - depth), depth);
+        updated->m_value.emplace(val);
+        inserted = true;
+    } else {
+        int len_node = radix_length(child->m_key);
+        int count    = radix_mismatch(key, depth, child->m_key, std::min(len_node, len - depth));
+
+        if (count == len_node) {
+            updated = insert(child, key, val, assign, inserted);
+            if (updated == child)
+                return n;
+        } else {
+            // split the edge to child at count
+            updated = new node(radix_substr(child->m_key, 0, count), depth);
+
+            node *tail = copy(child);
+            tail->m_key   = radix_substr(child->m_key, count, len_node - count);
+            tail->m_depth = depth + count;
+            set_child(updated->m_children, tail);
+
+            if (depth + count == len) {
+                updated->m_value.emplace(val);
+            } else {
+                node *leaf = new node(radix_substr(val.first, depth + count, len - depth - count), depth + count);
+                leaf->m_value.emplace(val);
+                set_child(updated->m_children, leaf);
+            }
+            inserted = true;
+        }
+    }
+
+    node *c = copy(n);
+    set_child(c->m_children, updated);
+    return c;
+}
+
+template <typename K, typename T>
+bool concurrent_radix_tree<K, T>::erase(const K &key)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+
+    node *root = m_root.load(std::memory_order_relaxed);
+    if (root == NULL)
+        return false;
+
+    node *updated = erase(root, key_view(key), true);
+    if (updated == root)
+        return false;
+
+    updated->m_refs++;
+    m_root.store(updated, std::memory_order_seq_cst);
+    release(root);
+    m_size.fetch_sub(1, std::memory_order_relaxed);
+
+    m_epoch.advance();
+    m_epoch.reclaim();
+
+    return true;
+}
+
+// returns n if key is not below n, NULL if n goes away, or n's replacement
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::node* concurrent_radix_tree<K, T>::erase(node *n, const key_view &key, bool is_root)
+{
+    int depth = n->end();
+    int len   = radix_length(key);
+
+    children_type children;
+    bool has_value;
+
+    if (depth == len) {
+        if (! n->m_value)
+            return n;
+
+        children  = n->m_children;
+        has_value = false;
+        for (std::size_t i = 0; i < children.size(); i++)
+            children[i].second->m_refs++;
+    } else {
+        node *child = n->child(key[depth]);
+        if (child == NULL)
+            return n;
+
+        int len_node = radix_length(child->m_key);
+        if (len_node > len - depth || ! radix_match(key, depth, child->m_key, len_node))
+            return n;
+
+        node *updated = erase(child, key, false);
+        if (updated == child)
+            return n;
+
+        children = n->m_children;
+        for (std::size_t i = 0; i < children.size(); i++)
+            children[i].second->m_refs++;
+        if (updated == NULL)
+            remove_child(children, child->m_key[0]);
+        else
+            set_child(children, updated);
+
+        has_value = static_cast<bool>(n->m_value);
+    }
+
+    // the root stays even when empty; other nodes without value must branch
+    if (! is_root && ! has_value) {
+        if (children.empty())
+            return NULL;
+        if (children.size() == 1)
+            return merge(n, children[0].second);
+    }
+
+    node *c = new node(n->m_key, n->m_depth);
+    if (has_value)
+        c->m_value.emplace(*n->m_value);
+    c->m_children.swap(children);
+    return c;
+}
+
+// replace a node left with a single child and no value by the child, with
+// the node's label prepended
+template <typename K, typename T>
+typename concurrent_radix_tree<K, T>::node* concurrent_radix_tree<K, T>::merge(node *n, node *child)
+{
+    node *c = copy(child);
+
+    c->m_key   = radix_join(n->m_key, child->m_key);
+    c->m_depth = n->m_depth;
+    // the reference taken for the list of n's children
+    release(child);
+
+    return c;
+}
+
+#endif // CONCURRENT_RADIX_TREE_HPP
@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 
 #include "../radix_tree.hpp"
+#include "../radix_tree_lpm.hpp"
 
 class rtentry {
 public:
@@ -67,6 +68,17 @@ int radix_length(const rtentry &entry)
 }
 
 radix_tree<rtentry, in_addr> rttable;
+poptrie_lpm<in_addr>         fib;    // compiled from rttable for forwarding
+
+void compile_fib()
+{
+    radix_tree<rtentry, in_addr>::iterator it;
+
+    for (it = rttable.begin(); it != rttable.end(); ++it)
+        fib.add(it->first.addr, it->first.prefix_len, it->second);
+
+    fib.rebuild();
+}
 
 void add_rtentry(const char *network, int prefix_len, const char *dst)
 {
@@ -120,6 +132,7 @@ void rm_rtentry(const char *network, int prefix_len)
     entry.prefix_len = prefix_len;
 
     rttable.erase(entry);
+    fib.erase(entry.addr, entry.prefix_len);
 }
 
 void find_route(const char *dst)
@@ -138,6 +151,11 @@ void find_route(const char *dst)
     radix_tree<rtentry, in_addr>::iterator it;
 
     it = rttable.longest_match(entry);
+
+    const in_addr *hop = fib.longest_match(entry.addr);
+    if ((hop == NULL) != (it == rttable.end()) || (hop != NULL && hop->s_addr != it->second.s_addr))
+        std::cout << "fib out of sync for " << dst << std::endl;
+
     if (it == rttable.end()) {
         std::cout << "no route to " << dst << std::endl;
         return;
@@ -163,6 +181,8 @@ main()
     add_rtentry("192.168.3.0", 24, "192.168.0.9");
     add_rtentry("192.168.4.0", 24, "192.168.0.10");
 
+    compile_fib();
+
     // lookup the routing table
     find_route("10.1.1.1");
     find_route("172.16.0.3");
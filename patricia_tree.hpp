@@ -0,0 +1,332 @@
+#ifndef PATRICIA_TREE_HPP
+#define PATRICIA_TREE_HPP
+
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+__extension__ typedef unsigned __int128 radix_uint128;
+
+/*
+ * Bit operations on the words a patricia_tree is keyed by. Bits are numbered
+ * from the most significant one, the way address prefixes are written.
+ */
+template <typename Word>
+struct radix_bits {
+    static const int width = sizeof(Word) * CHAR_BIT;
+
+    // leading zeros of x; width for x == 0
+    static int clz(Word x) {
+        if (x == 0)
+            return width;
+        if (sizeof(Word) <= sizeof(unsigned int))
+            return __builtin_clz(static_cast<unsigned int>(x)) - (int(sizeof(unsigned int)) - int(sizeof(Word))) * CHAR_BIT;
+        return __builtin_clzll(static_cast<unsigned long long>(x)) - (int(sizeof(unsigned long long)) - int(sizeof(Word))) * CHAR_BIT;
+    }
+
+    static Word mask(int len) { return len == 0 ? Word(0) : Word(~Word(0) << (width - len)); }
+    static int bit(Word x, int i) { return static_cast<int>((x >> (width - 1 - i)) & 1); }
+};
+
+template <>
+inline int radix_bits<radix_uint128>::clz(radix_uint128 x)
+{
+    unsigned long long hi = static_cast<unsigned long long>(x >> 64);
+    unsigned long long lo = static_cast<unsigned long long>(x);
+
+    if (hi != 0)
+        return __builtin_clzll(hi);
+    return lo == 0 ? 128 : 64 + __builtin_clzll(lo);
+}
+
+/*
+ * Path-compressed binary trie over fixed-width integer prefixes (addr, len),
+ * for IP routing tables. Every node stores its whole prefix left-aligned in
+ * one word, so a lookup checks a node with one XOR and mask, and insert finds
+ * the split point of two prefixes with one count-leading-zeros instead of
+ * comparing bit by bit.
+ *
+ * Address bits beyond the prefix length are ignored.
+ */
+template <typename Word, typename T>
+class patricia_tree {
+public:
+    typedef Word        word_type;
+    typedef T           mapped_type;
+    typedef std::size_t size_type;
+
+    static const int width = radix_bits<Word>::width;
+
+    patricia_tree() : m_root(NULL), m_size(0) { }
+    ~patricia_tree() { clear(); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear();
+
+    // returns the value stored for the prefix and whether it was inserted
+    std::pair<T*, bool> insert(Word addr, int len, const T &value);
+    bool erase(Word addr, int len);
+
+    // exact prefix
+    T* find(Word addr, int len);
+    const T* find(Word addr, int len) const { return const_cast<patricia_tree*>(this)->find(addr, len); }
+
+    // value of the longest stored prefix covering addr, NULL if none;
+    // the prefix length goes to *len when given
+    T* longest_match(Word addr, int *len = NULL);
+    const T* longest_match(Word addr, int *len = NULL) const { return const_cast<patricia_tree*>(this)->longest_match(addr, len); }
+
+    // as longest_match, considering only prefixes of at most maxlen bits
+    T* longest_match_upto(Word addr, int maxlen, int *len = NULL);
+    const T* longest_match_upto(Word addr, int maxlen, int *len = NULL) const { return const_cast<patricia_tree*>(this)->longest_match_upto(addr, maxlen, len); }
+
+    // f(addr, len, value) for every prefix, a prefix before the prefixes it contains
+    template <typename F> void for_each(F f) const;
+    // the same for the prefixes inside addr/len, including addr/len itself
+    template <typename F> void for_each_within(Word addr, int len, F f) const;
+
+private:
+    struct node {
+        node(Word key, int len) : m_key(key), m_len(static_cast<std::uint8_t>(len)) { m_child[0] = m_child[1] = NULL; }
+
+        Word             m_key; // prefix, bits past m_len are zero
+        std::uint8_t     m_len;
+        node            *m_child[2];
+        std::optional<T> m_value;
+    };
+
+    node     *m_root;
+    size_type m_size;
+
+    patricia_tree(const patricia_tree&); // delete
+    patricia_tree& operator=(const patricia_tree&); // delete
+
+    static bool covers(const node *n, Word addr) { return ((addr ^ n->m_key) & radix_bits<Word>::mask(n->m_len)) == 0; }
+
+    static void destroy(node *n);
+    template <typename F> static void for_each(const node *n, F &f);
+};
+
+template <typename T> using ipv4_radix_tree = patricia_tree<std::uint32_t, T>;
+template <typename T> using ipv6_radix_tree = patricia_tree<radix_uint128, T>;
+
+// IPv6 address in network byte order as a word for ipv6_radix_tree
+inline radix_uint128 radix_ipv6_word(const unsigned char bytes[16])
+{
+    radix_uint128 word = 0;
+    for (int i = 0; i < 16; i++)
+        word = (word << 8) | bytes[i];
+    return word;
+}
+
+template <typename Word, typename T>
+void patricia_tree<Word, T>::destroy(node *n)
+{
+    if (n == NULL)
+        return;
+
+    destroy(n->m_child[0]);
+    destroy(n->m_child[1]);
+    delete n;
+}
+
+template <typename Word, typename T>
+void patricia_tree<Word, T>::clear()
+{
+    destroy(m_root);
+    m_root = NULL;
+    m_size = 0;
+}
+
+template <typename Word, typename T>
+std::pair<T*, bool> patricia_tree<Word, T>::insert(Word addr, int len, const T &value)
+{
+    assert(len >= 0 && len <= width);
+
+    addr &= radix_bits<Word>::mask(len);
+
+    node **slot = &m_root;
+
+    while (*slot != NULL) {
+        node *n = *slot;
+
+        // length of the prefix shared by n and the new key
+        int common = radix_bits<Word>::clz(addr ^ n->m_key);
+        if (common > len)
+            common = len;
+        if (common > n->m_len)
+            common = n->m_len;
+
+        if (common < n->m_len) {
+            // the new key branches off, or ends, inside n's prefix;
+            // new nodes stay owned here until they are linked
+            if (common == len) {
+                std::unique_ptr<node> split(new node(addr, len));
+                split->m_value.emplace(value);
+                split->m_child[radix_bits<Word>::bit(n->m_key, len)] = n;
+                *slot = split.get();
+                m_size++;
+                return std::pair<T*, bool>(&*split.release()->m_value, true);
+            }
+
+            std::unique_ptr<node> leaf(new node(addr, len));
+            leaf->m_value.emplace(value);
+
+            node *split = new node(addr & radix_bits<Word>::mask(common), common);
+            split->m_child[radix_bits<Word>::bit(addr, common)]     = leaf.get();
+            split->m_child[radix_bits<Word>::bit(n->m_key, common)] = n;
+            *slot = split;
+            m_size++;
+            return std::pair<T*, bool>(&*leaf.release()->m_value, true);
+        }
+
+        if (n->m_len == len) {
+            if (n->m_value)
+                return std::pair<T*, bool>(&*n->m_value, false);
+
+            n->m_value.emplace(value);
+            m_size++;
+            return std::pair<T*, bool>(&*n->m_value, true);
+        }
+
+        slot = &n->m_child[radix_bits<Word>::bit(addr, n->m_len)];
+    }
+
+    std::unique_ptr<node> leaf(new node(addr, len));
+    leaf->m_value.emplace(value);
+    *slot = leaf.get();
+    m_size++;
+
+    return std::pair<T*, bool>(&*leaf.release()->m_value, true);
+}
+
+template <typename Word, typename T>
+T* patricia_tree<Word, T>::find(Word addr, int len)
+{
+    addr &= radix_bits<Word>::mask(len);
+
+    node *n = m_root;
+
+    while (n != NULL && n->m_len <= len && covers(n, addr)) {
+        if (n->m_len == len)
+            return n->m_value ? &*n->m_value : NULL;
+
+        n = n->m_child[radix_bits<Word>::bit(addr, n->m_len)];
+    }
+
+    return NULL;
+}
+
+template <typename Word, typename T>
+T* patricia_tree<Word, T>::longest_match(Word addr, int *len)
+{
+    return longest_match_upto(addr, width, len);
+}
+
+template <typename Word, typename T>
+T* patricia_tree<Word, T>::longest_match_upto(Word addr, int maxlen, int *len)
+{
+    node *n    = m_root;
+    node *best = NULL;
+
+    while (n != NULL && n->m_len <= maxlen && covers(n, addr)) {
+        if (n->m_value)
+            best = n;
+        if (n->m_len == width)
+            break;
+
+        n = n->m_child[radix_bits<Word>::bit(addr, n->m_len)];
+    }
+
+    if (best == NULL)
+        return NULL;
+
+    if (len != NULL)
+        *len = best->m_len;
+
+    return &*best->m_value;
+}
+
+template <typename Word, typename T>
+bool patricia_tree<Word, T>::erase(Word addr, int len)
+{
+    addr &= radix_bits<Word>::mask(len);
+
+    // slots on the path, so that emptied nodes can be unlinked
+    node **path[radix_bits<Word>::width + 2];
+    int    depth = 0;
+    node **slot  = &m_root;
+
+    while (*slot != NULL && (*slot)->m_len < len && covers(*slot, addr)) {
+        path[depth++] = slot;
+        slot = &(*slot)->m_child[radix_bits<Word>::bit(addr, (*slot)->m_len)];
+    }
+
+    node *n = *slot;
+    if (n == NULL || n->m_len != len || n->m_key != addr || ! n->m_value)
+        return false;
+
+    n->m_value.reset();
+    m_size--;
+
+    // a node without value has to branch; drop or bypass it otherwise
+    for (;;) {
+        n = *slot;
+        if (n->m_value || (n->m_child[0] != NULL && n->m_child[1] != NULL))
+            break;
+
+        *slot = n->m_child[0] != NULL ? n->m_child[0] : n->m_child[1];
+        delete n;
+
+        if (depth == 0 || *slot != NULL)
+            break;
+
+        slot = path[--depth];
+    }
+
+    return true;
+}
+
+template <typename Word, typename T>
+template <typename F>
+void patricia_tree<Word, T>::for_each(F f) const
+{
+    for_each(m_root, f);
+}
+
+template <typename Word, typename T>
+template <typename F>
+void patricia_tree<Word, T>::for_each_within(Word addr, int len, F f) const
+{
+    addr &= radix_bits<Word>::mask(len);
+
+    // descend to the first node whose prefix lies inside addr/len
+    const node *n = m_root;
+
+    while (n != NULL && n->m_len < len && covers(n, addr))
+        n = n->m_child[radix_bits<Word>::bit(addr, n->m_len)];
+
+    if (n != NULL && n->m_len >= len && ((n->m_key ^ addr) & radix_bits<Word>::mask(len)) == 0)
+        for_each(n, f);
+}
+
+template <typename Word, typename T>
+template <typename F>
+void patricia_tree<Word, T>::for_each(const node *n, F &f)
+{
+    if (n == NULL)
+        return;
+
+    if (n->m_value)
+        f(n->m_key, static_cast<int>(n->m_len), *n->m_value);
+
+    for_each(n->m_child[0], f);
+    for_each(n->m_child[1], f);
+}
+
+#endif // PATRICIA_TREE_HPP
@@ -1,13 +1,34 @@
 #ifndef RADIX_TREE_HPP
 #define RADIX_TREE_HPP
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "radix_tree_arena.hpp"
 #include "radix_tree_it.hpp"
 #include "radix_tree_node.hpp"
+#include "radix_tree_parallel.hpp"
 #include <functional>
 
 template<typename K>
@@ -37,520 +58,2181 @@ inline int radix_length<std::string>(const std::string &key)
     return static_cast<int>(key.size());
 }
 
-template <typename K, typename T, typename Compare>
+/*
+ * Lookups only read the key, so they run over a non-owning view of it and
+ * compare pieces of the key with edge labels in place instead of building
+ * substrings with radix_substr. std::string keys are viewed as
+ * std::string_view; other key types through radix_key_view, which forwards
+ * operator[] and radix_length to the key.
+ */
+template<typename K>
+class radix_key_view {
+public:
+    radix_key_view() : m_key(NULL) { }
+    radix_key_view(const K &key) : m_key(&key) { }
+
+    decltype(auto) operator[] (int n) const { return (*m_key)[n]; }
+    const K& key() const { return *m_key; }
+
+private:
+    const K *m_key;
+};
+
+template<typename K>
+int radix_length(const radix_key_view<K> &view)
+{
+    return radix_length(view.key());
+}
+
+inline int radix_length(const std::string_view &key)
+{
+    return static_cast<int>(key.size());
+}
+
+template<typename K>
+struct radix_key_traits {
+    typedef radix_key_view<K> view_type;
+};
+
+template<>
+struct radix_key_traits<std::string> {
+    typedef std::string_view view_type;
+};
+
+// lookup overloads taking anything viewable as a key, e.g. a string literal
+template<typename K, typename KeyLike>
+using radix_enable_if_view_t = std::enable_if_t<
+    std::is_convertible<const KeyLike&, typename radix_key_traits<K>::view_type>::value &&
+    !std::is_same<std::decay_t<KeyLike>, K>::value>;
+
+/*
+ * Index of the first byte where a[0, len) and b[0, len) differ, len if none.
+ * Compares 32 bytes a step with AVX2 or 16 with SSE2, whichever the target
+ * was compiled for, and the tail a word at a time.
+ */
+inline int radix_mismatch_bytes(const char *a, const char *b, int len)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        unsigned int diff = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+        if (diff != 0)
+            return i + __builtin_ctz(diff);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        unsigned int diff = ~static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) & 0xffff;
+        if (diff != 0)
+            return i + __builtin_ctz(diff);
+    }
+#endif
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i + 8 <= len; i += 8) {
+        std::uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        if (x != y)
+            return i + __builtin_ctzll(x ^ y) / 8;
+    }
+#endif
+    for (; i < len; i++) {
+        if (a[i] != b[i])
+            break;
+    }
+    return i;
+}
+
+// length of the common prefix of key[begin, begin + len) and label[0, len);
+// both must be long enough
+template<typename V, typename K>
+int radix_mismatch(const V &key, int begin, const K &label, int len)
+{
+    int i;
+    for (i = 0; i < len; i++) {
+        if (! (key[begin + i] == label[i]))
+            break;
+    }
+    return i;
+}
+
+inline int radix_mismatch(const std::string_view &key, int begin, const std::string &label, int len)
+{
+    return radix_mismatch_bytes(key.data() + begin, label.data(), len);
+}
+
+// true if key[begin, begin + len) equals label[0, len); both must be long enough
+template<typename V, typename K>
+bool radix_match(const V &key, int begin, const K &label, int len)
+{
+    return radix_mismatch(key, begin, label, len) == len;
+}
+
+/*
+ * Shape and memory of a radix_tree as returned by radix_tree::stats().
+ *
+ * Bytes are what the tree asked its allocator for: nodes, child tables
+ * (std::map nodes counted as entry plus tree links) and key bytes kept on
+ * the heap by the key type; allocator headers and heap owned by mapped
+ * values are not included.
+ */
+struct radix_tree_stats {
+    std::size_t entries        = 0;
+    std::size_t nodes          = 0;
+    std::size_t internal_nodes = 0; // nodes with children, the root included
+    std::size_t leaf_nodes     = 0;
+    std::size_t value_nodes    = 0; // nodes allocated with value storage
+    std::size_t layouts[4]     = { }; // adaptive child tables by kind: node4, node16, node48, node256
+
+    std::vector<std::size_t> fanout; // fanout[n]: nodes with n children
+    std::vector<std::size_t> depth;  // depth[d]: nodes d edges below the root
+
+    std::size_t label_bytes = 0; // edge label lengths, in key elements
+    std::size_t node_bytes  = 0;
+    std::size_t table_bytes = 0;
+    std::size_t key_bytes   = 0;
+
+    std::size_t allocated_bytes() const { return node_bytes + table_bytes + key_bytes; }
+    double bytes_per_key() const { return entries == 0 ? 0.0 : static_cast<double>(allocated_bytes()) / entries; }
+};
+
+template <typename K, typename T, typename Compare, typename Alloc>
 class radix_tree {
+    template <typename> friend class radix_tree_image;
+
 public:
     typedef K key_type;
     typedef T mapped_type;
     typedef std::pair<const K, T> value_type;
-    typedef radix_tree_it<K, T, Compare>   iterator;
+    typedef radix_tree_it<K, T, Compare, Alloc>   iterator;
+    typedef radix_tree_it<K, T, Compare, Alloc, true> const_iterator;
+    typedef std::ranges::subrange<iterator>       range;
+    typedef std::ranges::subrange<const_iterator> const_range;
     typedef std::size_t           size_type;
-
-	radix_tree() : m_size(0), m_root(NULL), m_predicate(Compare()) { }
-	explicit radix_tree(Compare pred) : m_size(0), m_root(NULL), m_predicate(pred) { }
+    typedef Alloc                 allocator_type;
+    typedef typename radix_key_traits<K>::view_type key_view;
+
+	radix_tree() : m_size(0), m_root(NULL), m_predicate(Compare()), m_alloc() { radix_tree_bulk_release<Alloc>::attach(m_alloc); }
+	explicit radix_tree(Compare pred) : m_size(0), m_root(NULL), m_predicate(pred), m_alloc() { radix_tree_bulk_release<Alloc>::attach(m_alloc); }
+	explicit radix_tree(const Alloc &alloc) : m_size(0), m_root(NULL), m_predicate(Compare()), m_alloc(alloc) { radix_tree_bulk_release<Alloc>::attach(m_alloc); }
+	radix_tree(Compare pred, const Alloc &alloc) : m_size(0), m_root(NULL), m_predicate(pred), m_alloc(alloc) { radix_tree_bulk_release<Alloc>::attach(m_alloc); }
+    template <std::input_iterator It>
+    radix_tree(It first, It last, unsigned threads = 1) : m_size(0), m_root(NULL), m_predicate(Compare()), m_alloc() {
+        radix_tree_bulk_release<Alloc>::attach(m_alloc);
+        try {
+            bulk_load(first, last, threads);
+        } catch (...) {
+            clear();
+            radix_tree_bulk_release<Alloc>::detach(m_alloc);
+            throw;
+        }
+    }
+    // copies the other tree's nodes as they are, without a lookup per key,
+    // laid out the way compact() leaves them
+    radix_tree(const radix_tree &other) : radix_tree(other, std::allocator_traits<Alloc>::select_on_container_copy_construction(other.m_alloc)) { }
+    radix_tree(const radix_tree &other, const Alloc &alloc);
+    // takes over the other tree's nodes and leaves it empty; iterators to
+    // entries stay valid, end() does not
+    radix_tree(radix_tree &&other) noexcept : m_size(other.m_size), m_root(other.m_root), m_predicate(other.m_predicate), m_alloc(other.m_alloc) {
+        radix_tree_bulk_release<Alloc>::attach(m_alloc);
+        other.m_root = NULL;
+        other.m_size = 0;
+    }
     ~radix_tree() {
-        delete m_root;
+        clear();
+        radix_tree_bulk_release<Alloc>::detach(m_alloc);
     }
 
+    radix_tree& operator=(const radix_tree &other);
+    // takes over the nodes unless the allocators differ and do not
+    // propagate; then the entries are moved into new nodes
+    radix_tree& operator=(radix_tree &&other);
+    void swap(radix_tree &other) noexcept;
+
     size_type size()  const {
         return m_size;
     }
     bool empty() const {
         return m_size == 0;
     }
-    void clear() {
-        delete m_root;
-        m_root = NULL;
-        m_size = 0;
-    }
+    void clear();
 
-    iterator find(const K &key);
-    iterator begin();
-    iterator end();
+    allocator_type get_allocator() const {
+        return m_alloc;
+    }
 
-    std::pair<iterator, bool> insert(const value_type &val);
+    iterator find(const K &key) { return find(key_view(key)); }
+    const_iterator find(const K &key) const { return find(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    iterator find(const KeyLike &key) { return iterator(find_exact(key_view(key)), &m_root); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    const_iterator find(const KeyLike &key) const { return const_iterator(find_exact(key_view(key)), &m_root); }
+    iterator begin() { return iterator(first_node(), &m_root); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator cbegin() const { return const_iterator(first_node(), &m_root); }
+    iterator end() { return iterator(NULL, &m_root); }
+    const_iterator end() const { return cend(); }
+    const_iterator cend() const { return const_iterator(NULL, &m_root); }
+
+    std::pair<iterator, bool> insert(const value_type &val) { return insert_unique(val.first, val); }
+    std::pair<iterator, bool> insert(value_type &&val) { return insert_unique(val.first, std::move(val)); }
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args&&... args);
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K &&key, Args&&... args);
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K &key, M &&obj);
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K &&key, M &&obj);
+    // inserts the entries of [first, last) like insert() and returns how many
+    // were added. Entries sorted by key are placed in a single pass, each
+    // next to the previous one, without a lookup from the root; the rest
+    // are still inserted correctly, only slower. With threads > 1, a random
+    // access range and a stateless allocator, the range is cut into parts by
+    // first key element and the parts are built on that many threads.
+    template <std::input_iterator It>
+    size_type bulk_load(It first, It last, unsigned threads = 1);
     bool erase(const K &key);
-    void erase(iterator it);
-    void prefix_match(const K &key, std::vector<iterator> &vec);
-    void greedy_match(const K &key,  std::vector<iterator> &vec);
-    iterator longest_match(const K &key);
-
-    T& operator[] (const K &lhs);
-
-	template<class _UnaryPred> void remove_if(_UnaryPred pred)
-	{
-		radix_tree<K, T, Compare>::iterator backIt;
-		for (radix_tree<K, T, Compare>::iterator it = begin(); it != end(); it = backIt)
-		{
-			backIt = it;
-			backIt++;
-			K toDelete = (*it).first;
-			if (pred(toDelete))
-			{
-				erase(toDelete);
-			}
-		}
-	}
-
+    // erase through the node the iterator points at, without a lookup;
+    // returns the iterator following the erased entry
+    iterator erase(iterator it) { return erase(const_iterator(it)); }
+    iterator erase(const_iterator it);
+    iterator erase(const_iterator first, const_iterator last);
+    // erases all entries whose key starts with key: their subtree is cut off
+    // in one step and freed, and compression is restored once above it.
+    // Returns the number of entries erased.
+    size_type erase_prefix(const key_view &key);
+    // moves the entries whose key starts with key into a new tree sharing
+    // this one's allocator; their nodes are handed over, not copied
+    radix_tree extract_prefix(const key_view &key);
+    void prefix_match(const K &key, std::vector<iterator> &vec) { prefix_match(key_view(key), vec); }
+    void prefix_match(const K &key, std::vector<const_iterator> &vec) const { prefix_match(key_view(key), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void prefix_match(const KeyLike &key, std::vector<iterator> &vec) { vec.clear(); collect(prefix_node(key_view(key)), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void prefix_match(const KeyLike &key, std::vector<const_iterator> &vec) const { vec.clear(); collect(prefix_node(key_view(key)), vec); }
+    void greedy_match(const K &key,  std::vector<iterator> &vec) { greedy_match(key_view(key), vec); }
+    void greedy_match(const K &key,  std::vector<const_iterator> &vec) const { greedy_match(key_view(key), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void greedy_match(const KeyLike &key, std::vector<iterator> &vec) { vec.clear(); collect(greedy_node(key_view(key)), vec); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    void greedy_match(const KeyLike &key, std::vector<const_iterator> &vec) const { vec.clear(); collect(greedy_node(key_view(key)), vec); }
+    iterator longest_match(const K &key) { return longest_match(key_view(key)); }
+    const_iterator longest_match(const K &key) const { return longest_match(key_view(key)); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    iterator longest_match(const KeyLike &key) { return iterator(longest_node(key_view(key)), &m_root); }
+    template <typename KeyLike, typename = radix_enable_if_view_t<K, KeyLike> >
+    const_iterator longest_match(const KeyLike &key) const { return const_iterator(longest_node(key_view(key)), &m_root); }
+
+    // results[i] = find(keys[i]) resp. longest_match(keys[i]) for a random
+    // access range of keys. Several lookups descend together, each
+    // prefetching its next node while the others run, so that their cache
+    // misses overlap instead of queueing up. results needs a slot per key;
+    // if it is shorter, only that many keys are looked up.
+    template <typename Keys>
+    void find_batch(const Keys &keys, std::span<iterator> results) { lookup_batch(keys, results, false); }
+    template <typename Keys>
+    void find_batch(const Keys &keys, std::span<const_iterator> results) const { lookup_batch(keys, results, false); }
+    template <typename Keys>
+    void longest_match_batch(const Keys &keys, std::span<iterator> results) { lookup_batch(keys, results, true); }
+    template <typename Keys>
+    void longest_match_batch(const Keys &keys, std::span<const_iterator> results) const { lookup_batch(keys, results, true); }
+
+    // the entries below a key form one stretch of the iteration order, so
+    // these walk it lazily instead of collecting iterators up front
+    range prefix_range(const key_view &key) { return subtree<iterator>(prefix_node(key)); }
+    const_range prefix_range(const key_view &key) const { return subtree<const_iterator>(prefix_node(key)); }
+    range greedy_range(const key_view &key) { return subtree<iterator>(greedy_node(key)); }
+    const_range greedy_range(const key_view &key) const { return subtree<const_iterator>(greedy_node(key)); }
+    // calls f on the entries of prefix_range(key) until it returns false;
+    // returns false if f stopped the walk
+    template <typename F>
+    bool prefix_visit(const key_view &key, F f) { return visit(prefix_range(key), f); }
+    template <typename F>
+    bool prefix_visit(const key_view &key, F f) const { return visit(prefix_range(key), f); }
+
+    T& operator[] (const K &lhs) { return try_emplace(lhs).first->second; }
+    T& operator[] (K &&lhs) { return try_emplace(std::move(lhs)).first->second; }
+
+    // calls f on every entry, resp. on the entries of prefix_range(key), from
+    // up to threads threads at once and in no particular order. f may modify
+    // the values it is given but not the tree.
+    template <typename F>
+    void parallel_for_each(F f, unsigned threads) { parallel_visit(m_root, f, threads); }
+    template <typename F>
+    void parallel_for_each(const key_view &key, F f, unsigned threads) { parallel_visit(prefix_node(key), f, threads); }
+    // remove_if with pred evaluated on up to threads threads at once; the
+    // matching entries are then erased on the calling thread. Returns the
+    // number of entries erased.
+    template <typename P>
+    size_type parallel_remove_if(P pred, unsigned threads);
+
+    // erases the entries whose key satisfies pred in one pass over the tree
+    // and returns their number
+    template <typename P>
+    size_type remove_if(P pred);
+
+    // node counts, histograms and memory, gathered in one pass over the
+    // nodes; keys and values are not read unless their type keeps bytes on
+    // the heap
+    radix_tree_stats stats() const;
+
+    // rebuilds the nodes in van Emde Boas order, so that the nodes a lookup
+    // passes lie close together however scattered insert and erase left
+    // them: the top half of the levels first, then each subtree below them,
+    // both laid out the same way. Child tables and copies of the keys are
+    // allocated in the same order, and nodes that kept value storage after
+    // an erase become plain nodes. If the tree is the only user of its
+    // allocator, as with a radix_tree_arena of its own, the new nodes fill
+    // fresh memory and the old memory is released at once; otherwise it is
+    // freed node by node. Invalidates iterators. If an allocation fails the
+    // tree is left as it was.
+    void compact();
 
 private:
     size_type m_size;
-    radix_tree_node<K, T, Compare>* m_root;
+    radix_tree_node<K, T, Compare, Alloc>* m_root;
 
 	Compare m_predicate;
+    [[no_unique_address]] Alloc m_alloc;
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<radix_tree_node<K, T, Compare, Alloc> > node_allocator;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<radix_tree_value_node<K, T, Compare, Alloc> > value_node_allocator;
+
+    radix_tree_node<K, T, Compare, Alloc>* new_node();
+    radix_tree_node<K, T, Compare, Alloc>* new_root(const K &key);
+    template <typename... Args>
+    radix_tree_node<K, T, Compare, Alloc>* new_value_node(Args&&... args);
+    void free_node(radix_tree_node<K, T, Compare, Alloc> *node);
+    void destroy(radix_tree_node<K, T, Compare, Alloc> *node, bool deallocate);
+
+    // read-only lookups shared by the iterator and const_iterator overloads
+    radix_tree_node<K, T, Compare, Alloc>* first_node() const;
+    radix_tree_node<K, T, Compare, Alloc>* find_exact(const key_view &key) const;
+    radix_tree_node<K, T, Compare, Alloc>* prefix_node(const key_view &key) const;
+    radix_tree_node<K, T, Compare, Alloc>* greedy_node(const key_view &key) const;
+    radix_tree_node<K, T, Compare, Alloc>* longest_node(const key_view &key) const;
+    template <typename It>
+    void collect(radix_tree_node<K, T, Compare, Alloc> *node, std::vector<It> &vec) const;
+    template <typename It>
+    std::ranges::subrange<It> subtree(radix_tree_node<K, T, Compare, Alloc> *node) const;
+    template <typename Range, typename F>
+    static bool visit(const Range &range, F &f);
+
+    // lookups in flight in lookup_batch
+    enum { batch_window = 16 };
+    template <typename Keys, typename It>
+    void lookup_batch(const Keys &keys, std::span<It> results, bool longest) const;
+
+    // edge labels, stored as K or as radix_tree_compact_label
+    static int label_length(const radix_tree_node<K, T, Compare, Alloc> *node);
+    static const char* label_data(const radix_tree_node<K, T, Compare, Alloc> *node);
+    template <typename V>
+    static int label_mismatch(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, int begin, int len);
+    template <typename V>
+    static bool head_matches(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, int begin, int len);
+    template <typename V>
+    static radix_tree_node<K, T, Compare, Alloc>* check_path(radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool &diverged);
+    static radix_tree_node<K, T, Compare, Alloc>* leaf_below(radix_tree_node<K, T, Compare, Alloc> *node);
+    static void set_label(radix_tree_node<K, T, Compare, Alloc> *node, const K &key, int begin, int len);
+    static typename radix_tree_node<K, T, Compare, Alloc>::label_type make_label(const K &key, int begin, int len);
+    static void cut_label(radix_tree_node<K, T, Compare, Alloc> *dst, const radix_tree_node<K, T, Compare, Alloc> *src, int begin, int len);
+    static typename radix_tree_node<K, T, Compare, Alloc>::label_type joined_label(const radix_tree_node<K, T, Compare, Alloc> *child, const radix_tree_node<K, T, Compare, Alloc> *parent);
+
+    template <typename V>
+    radix_tree_node<K, T, Compare, Alloc>* find_node(const V &key, radix_tree_node<K, T, Compare, Alloc> *node, int depth, bool *diverged = NULL) const;
+    template <typename V>
+    bool is_exact(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool diverged) const;
+    template <typename V>
+    radix_tree_node<K, T, Compare, Alloc>* matched_node(radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool diverged, bool longest) const;
+    template <typename... Args>
+    std::pair<iterator, bool> insert_unique(const K &key, Args&&... args);
+    template <typename... Args>
+    std::pair<radix_tree_node<K, T, Compare, Alloc>*, bool> place(radix_tree_node<K, T, Compare, Alloc> *node, const key_view &key, Args&&... args);
+    template <typename It>
+    void load_sorted(radix_tree_node<K, T, Compare, Alloc> *&root, It first, It last, size_type &count);
+    template <typename It>
+    void load_parallel(It first, It last, unsigned threads);
+    template <typename F>
+    void load_parts(std::size_t parts, unsigned threads, F load);
+    void split(radix_tree_node<K, T, Compare, Alloc> *node, std::size_t want, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &subtrees, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &singles) const;
+    template <typename F>
+    void parallel_visit(radix_tree_node<K, T, Compare, Alloc> *node, F &f, unsigned threads);
+    void graft(radix_tree_node<K, T, Compare, Alloc> *root);
+    void absorb(radix_tree_node<K, T, Compare, Alloc> *node);
+    template <typename... Args>
+    radix_tree_node<K, T, Compare, Alloc>* append(radix_tree_node<K, T, Compare, Alloc> *parent, Args&&... args);
+    template <typename... Args>
+    radix_tree_node<K, T, Compare, Alloc>* prepend(radix_tree_node<K, T, Compare, Alloc> *node, const key_view &key, Args&&... args);
+    template <typename... Args>
+    radix_tree_node<K, T, Compare, Alloc>* store(radix_tree_node<K, T, Compare, Alloc> *node, Args&&... args);
+    void erase_node(radix_tree_node<K, T, Compare, Alloc> *node);
+    void detach(radix_tree_node<K, T, Compare, Alloc> *node, size_type &count);
+    static size_type count_entries(const radix_tree_node<K, T, Compare, Alloc> *node);
+    static void tally(const radix_tree_node<K, T, Compare, Alloc> *node, std::size_t level, radix_tree_stats &stats);
+
+    // a node in the order compact() builds, with the position of its parent
+    struct placement {
+        radix_tree_node<K, T, Compare, Alloc> *node;
+        std::size_t parent;
+    };
+    static int height(const radix_tree_node<K, T, Compare, Alloc> *node);
+    static void layout(radix_tree_node<K, T, Compare, Alloc> *root, std::vector<placement> &order);
+    static void layout(radix_tree_node<K, T, Compare, Alloc> *node, std::size_t parent, int height, std::vector<placement> &order, std::vector<placement> &below);
+    template <typename F>
+    void rebuild(const std::vector<placement> &order, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &nodes, F make);
+    template <bool Move>
+    radix_tree_node<K, T, Compare, Alloc>* clone(radix_tree_node<K, T, Compare, Alloc> *root);
+    // what merging a node into its only child changes in the child: made
+    // by join(), which may throw, before merge() commits it
+    struct merged_label {
+        typename radix_tree_node<K, T, Compare, Alloc>::label_type label;
+        typename radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key slot;
+    };
+    static merged_label join(const radix_tree_node<K, T, Compare, Alloc> *node, const radix_tree_node<K, T, Compare, Alloc> *child);
+    void merge(radix_tree_node<K, T, Compare, Alloc> *node, merged_label &&joined);
+    radix_tree_node<K, T, Compare, Alloc>* merge_partner(const radix_tree_node<K, T, Compare, Alloc> *node) const;
+
+    // takes over a detached subtree
+    radix_tree(const Compare &pred, const Alloc &alloc, radix_tree_node<K, T, Compare, Alloc> *root, size_type size) : m_size(size), m_root(root), m_predicate(pred), m_alloc(alloc) { radix_tree_bulk_release<Alloc>::attach(m_alloc); }
 
-    radix_tree_node<K, T, Compare>* begin(radix_tree_node<K, T, Compare> *node);
-    radix_tree_node<K, T, Compare>* find_node(const K &key, radix_tree_node<K, T, Compare> *node, int depth);
-    radix_tree_node<K, T, Compare>* append(radix_tree_node<K, T, Compare> *parent, const value_type &val);
-    radix_tree_node<K, T, Compare>* prepend(radix_tree_node<K, T, Compare> *node, const value_type &val);
-	void greedy_match(radix_tree_node<K, T, Compare> *node, std::vector<iterator> &vec);
-
-    radix_tree(const radix_tree& other); // delete
-    radix_tree& operator =(const radix_tree other); // delete
 };
 
-template <typename K, typename T, typename Compare>
-void radix_tree<K, T, Compare>::prefix_match(const K &key, std::vector<iterator> &vec)
+template <typename K, typename T, typename Compare, typename Alloc>
+void swap(radix_tree<K, T, Compare, Alloc> &lhs, radix_tree<K, T, Compare, Alloc> &rhs) noexcept
 {
-    vec.clear();
-
-    if (m_root == NULL)
-        return;
+    lhs.swap(rhs);
+}
 
-    radix_tree_node<K, T, Compare> *node;
-    K key_sub1, key_sub2;
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree<K, T, Compare, Alloc>::radix_tree(const radix_tree &other, const Alloc &alloc) : m_size(0), m_root(NULL), m_predicate(other.m_predicate), m_alloc(alloc)
+{
+    radix_tree_bulk_release<Alloc>::attach(m_alloc);
+    try {
+        m_root = clone<false>(other.m_root);
+    } catch (...) {
+        radix_tree_bulk_release<Alloc>::detach(m_alloc);
+        throw;
+    }
+    m_size = other.m_size;
+}
 
-    node = find_node(key, m_root, 0);
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree<K, T, Compare, Alloc>& radix_tree<K, T, Compare, Alloc>::operator=(const radix_tree &other)
+{
+    typedef std::allocator_traits<Alloc> traits;
 
-    if (node->m_is_leaf)
-        node = node->m_parent;
+    if (this == &other)
+        return *this;
 
-    int len = radix_length(key) - node->m_depth;
-    key_sub1 = radix_substr(key, node->m_depth, len);
-    key_sub2 = radix_substr(node->m_key, 0, len);
+    // copy first, so that a failure leaves this tree as it was
+    radix_tree copy(other, traits::propagate_on_container_copy_assignment::value ? other.m_alloc : m_alloc);
 
-    if (key_sub1 != key_sub2)
-        return;
+    clear();
+    if constexpr (traits::propagate_on_container_copy_assignment::value) {
+        radix_tree_bulk_release<Alloc>::detach(m_alloc);
+        m_alloc = other.m_alloc;
+        radix_tree_bulk_release<Alloc>::attach(m_alloc);
+    }
+    m_predicate = other.m_predicate;
+    std::swap(m_root, copy.m_root);
+    std::swap(m_size, copy.m_size);
 
-    greedy_match(node, vec);
+    return *this;
 }
 
-template <typename K, typename T, typename Compare>
-typename radix_tree<K, T, Compare>::iterator radix_tree<K, T, Compare>::longest_match(const K &key)
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree<K, T, Compare, Alloc>& radix_tree<K, T, Compare, Alloc>::operator=(radix_tree &&other)
 {
-    if (m_root == NULL)
-        return iterator(NULL);
-
-    radix_tree_node<K, T, Compare> *node;
-    K key_sub;
+    typedef std::allocator_traits<Alloc> traits;
+
+    if (this == &other)
+        return *this;
+
+    if constexpr (! traits::propagate_on_container_move_assignment::value) {
+        if (! traits::is_always_equal::value && ! (m_alloc == other.m_alloc)) {
+            // nodes cannot change allocators; build the new ones first, so
+            // that a failure leaves this tree as it was
+            radix_tree copy(other.m_predicate, m_alloc, NULL, 0);
+            copy.m_root = copy.template clone<true>(other.m_root);
+            copy.m_size = other.m_size;
+
+            clear();
+            m_predicate = other.m_predicate;
+            std::swap(m_root, copy.m_root);
+            std::swap(m_size, copy.m_size);
+            other.clear();
+            return *this;
+        }
+    }
 
-    node = find_node(key, m_root, 0);
+    clear();
+    m_predicate = other.m_predicate;
 
-    if (node->m_is_leaf)
-        return iterator(node);
+    if constexpr (traits::propagate_on_container_move_assignment::value) {
+        radix_tree_bulk_release<Alloc>::detach(m_alloc);
+        m_alloc = other.m_alloc;
+        radix_tree_bulk_release<Alloc>::attach(m_alloc);
+    }
 
-    key_sub = radix_substr(key, node->m_depth, radix_length(node->m_key));
+    std::swap(m_root, other.m_root);
+    std::swap(m_size, other.m_size);
 
-    if (! (key_sub == node->m_key))
-        node = node->m_parent;
+    return *this;
+}
 
-    K nul = radix_substr(key, 0, 0);
+// allocators are swapped only if they propagate; otherwise they must be equal
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::swap(radix_tree &other) noexcept
+{
+    std::swap(m_root, other.m_root);
+    std::swap(m_size, other.m_size);
+    std::swap(m_predicate, other.m_predicate);
+    if constexpr (std::allocator_traits<Alloc>::propagate_on_container_swap::value)
+        std::swap(m_alloc, other.m_alloc);
+}
 
-    while (node != NULL) {
-        typename radix_tree_node<K, T, Compare>::it_child it;
-        it = node->m_children.find(nul);
-        if (it != node->m_children.end() && it->second->m_is_leaf)
-            return iterator(it->second);
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::new_node()
+{
+    node_allocator alloc(m_alloc);
+    radix_tree_node<K, T, Compare, Alloc> *node = alloc.allocate(1);
 
-        node = node->m_parent;
-    }
+    RADIX_TREE_COUNT(allocations, 1);
+    ::new (static_cast<void*>(node)) radix_tree_node<K, T, Compare, Alloc>(m_predicate, m_alloc);
 
-    return iterator(NULL);
+    return node;
 }
 
-
-template <typename K, typename T, typename Compare>
-typename radix_tree<K, T, Compare>::iterator radix_tree<K, T, Compare>::end()
+// an empty root; its label is cut from key so that it has the label type's
+// notion of empty
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::new_root(const K &key)
 {
-    return iterator(NULL);
+    radix_tree_node<K, T, Compare, Alloc> *node = new_node();
+
+    set_label(node, key, 0, 0);
+
+    return node;
 }
 
-template <typename K, typename T, typename Compare>
-typename radix_tree<K, T, Compare>::iterator radix_tree<K, T, Compare>::begin()
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::new_value_node(Args&&... args)
 {
-    radix_tree_node<K, T, Compare> *node;
-
-    if (m_root == NULL || m_size == 0)
-        node = NULL;
-    else
-        node = begin(m_root);
+    value_node_allocator alloc(m_alloc);
+    radix_tree_value_node<K, T, Compare, Alloc> *node = alloc.allocate(1);
+
+    RADIX_TREE_COUNT(allocations, 1);
+    try {
+        ::new (static_cast<void*>(node)) radix_tree_value_node<K, T, Compare, Alloc>(m_predicate, m_alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        alloc.deallocate(node, 1);
+        throw;
+    }
 
-    return iterator(node);
+    return node;
 }
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree<K, T, Compare>::begin(radix_tree_node<K, T, Compare> *node)
+// free a single node; its children must have been moved away or freed
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::free_node(radix_tree_node<K, T, Compare, Alloc> *node)
 {
-    if (node->m_is_leaf)
-        return node;
+    node->m_children.release(m_alloc);
 
+    if (node->m_has_storage) {
+        value_node_allocator alloc(m_alloc);
+        radix_tree_value_node<K, T, Compare, Alloc> *value_node = static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(node);
 
-    assert(!node->m_children.empty());
+        value_node->~radix_tree_value_node();
+        alloc.deallocate(value_node, 1);
+    } else {
+        node_allocator alloc(m_alloc);
 
-    return begin(node->m_children.begin()->second);
+        node->~radix_tree_node();
+        alloc.deallocate(node, 1);
+    }
 }
 
-template <typename K, typename T, typename Compare>
-T& radix_tree<K, T, Compare>::operator[] (const K &lhs)
+// destroy a whole subtree; without deallocate only destructors run and the
+// memory is left to a bulk release of the allocator
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::destroy(radix_tree_node<K, T, Compare, Alloc> *node, bool deallocate)
 {
-    iterator it = find(lhs);
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        destroy(child, deallocate);
+    });
 
-    if (it == end()) {
-        std::pair<K, T> val;
-        val.first = lhs;
-
-        std::pair<iterator, bool> ret;
-        ret = insert(val);
+    if (deallocate) {
+        free_node(node);
+        return;
+    }
 
-        assert(ret.second == true);
+    node->m_children.abandon();
+    if (node->m_has_storage)
+        static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(node)->~radix_tree_value_node();
+    else
+        node->~radix_tree_node();
+}
 
-        it = ret.first;
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::clear()
+{
+    if (m_root != NULL) {
+        if (radix_tree_bulk_release<Alloc>::exclusive(m_alloc)) {
+            // the allocator only serves this tree: drop its memory in one go
+            // and walk the tree only if something needs its destructor run
+            if (! std::is_trivially_destructible<K>::value || ! std::is_trivially_destructible<T>::value)
+                destroy(m_root, false);
+            radix_tree_bulk_release<Alloc>::release(m_alloc);
+        } else {
+            destroy(m_root, true);
+        }
     }
 
-    return it->second;
+    m_root = NULL;
+    m_size = 0;
 }
 
-template <typename K, typename T, typename Compare>
-void radix_tree<K, T, Compare>::greedy_match(const K &key, std::vector<iterator> &vec)
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::first_node() const
 {
-    radix_tree_node<K, T, Compare> *node;
+    if (m_root == NULL || m_size == 0)
+        return NULL;
 
-    vec.clear();
+    return iterator::descend(m_root);
+}
 
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::find_exact(const key_view &key) const
+{
     if (m_root == NULL)
-        return;
+        return NULL;
 
-    node = find_node(key, m_root, 0);
+    bool diverged;
+    RADIX_TREE_COUNT(lookups, 1);
+    radix_tree_node<K, T, Compare, Alloc> *node = find_node(key, m_root, 0, &diverged);
 
-    if (node->m_is_leaf)
-        node = node->m_parent;
-
-    greedy_match(node, vec);
+    return matched_node(node, key, diverged, false);
 }
 
-template <typename K, typename T, typename Compare>
-void radix_tree<K, T, Compare>::greedy_match(radix_tree_node<K, T, Compare> *node, std::vector<iterator> &vec)
+// the subtree holding all keys that start with key
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::prefix_node(const key_view &key) const
 {
-    if (node->m_is_leaf) {
-        vec.push_back(iterator(node));
-        return;
-    }
+    if (m_root == NULL)
+        return NULL;
 
-	typename std::map<K, radix_tree_node<K, T, Compare>*>::iterator it;
+    RADIX_TREE_COUNT(lookups, 1);
+    radix_tree_node<K, T, Compare, Alloc> *node = find_node(key, m_root, 0);
 
-    for (it = node->m_children.begin(); it != node->m_children.end(); ++it) {
-        greedy_match(it->second, vec);
-    }
+    // the rest of the key has to be a prefix of the node's label
+    int len = radix_length(key) - node->m_depth;
+
+    if (len > label_length(node) || label_mismatch(node, key, node->m_depth, len) != len)
+        return NULL;
+
+    return node;
 }
 
-template <typename K, typename T, typename Compare>
-void radix_tree<K, T, Compare>::erase(iterator it)
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::greedy_node(const key_view &key) const
 {
-    erase(it->first);
+    if (m_root == NULL)
+        return NULL;
+
+    RADIX_TREE_COUNT(lookups, 1);
+    return find_node(key, m_root, 0);
 }
 
-template <typename K, typename T, typename Compare>
-bool radix_tree<K, T, Compare>::erase(const K &key)
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::longest_node(const key_view &key) const
 {
-	if (m_root == NULL)
-		return 0;
+    if (m_root == NULL)
+        return NULL;
 
-	radix_tree_node<K, T, Compare> *child;
-    radix_tree_node<K, T, Compare> *parent;
-    radix_tree_node<K, T, Compare> *grandparent;
-    K nul = radix_substr(key, 0, 0);
+    radix_tree_node<K, T, Compare, Alloc> *node;
+    bool diverged;
 
-    child = find_node(key, m_root, 0);
+    RADIX_TREE_COUNT(lookups, 1);
+    node = find_node(key, m_root, 0, &diverged);
 
-    if (! child->m_is_leaf)
-        return 0;
+    return matched_node(node, key, diverged, true);
+}
 
-    parent = child->m_parent;
-    parent->m_children.erase(nul);
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename Keys, typename It>
+void radix_tree<K, T, Compare, Alloc>::lookup_batch(const Keys &keys, std::span<It> results, bool longest) const
+{
+    typedef radix_tree_node<K, T, Compare, Alloc> node_type;
+
+    // child, when set, has been prefetched and is compared with the key on
+    // the next step; otherwise the next step picks and prefetches the child
+    struct lookup {
+        key_view    key;
+        node_type  *node;
+        node_type  *child;
+        int         depth;
+        std::size_t index;
+        bool        tails;  // see find_node
+    };
+
+    assert(results.size() >= std::size(keys));
+    std::size_t count = std::min<std::size_t>(std::size(keys), results.size());
 
-    delete child;
+    if (m_root == NULL) {
+        for (std::size_t i = 0; i < count; i++)
+            results[i] = It(NULL, &m_root);
+        return;
+    }
 
-    m_size--;
+    auto start = [&](lookup &l, std::size_t index) {
+        l.key   = key_view(keys[index]);
+        l.node  = m_root;
+        l.child = NULL;
+        l.depth = 0;
+        l.index = index;
+        l.tails = false;
+        RADIX_TREE_COUNT(lookups, 1);
+        RADIX_TREE_COUNT(nodes_visited, 1);
+    };
+
+    // one step of find_node; true once the lookup has stopped at l.node
+    auto step = [](lookup &l, bool &diverged) {
+        int len_key = radix_length(l.key) - l.depth;
+
+        diverged = false;
+
+        if (l.child != NULL) {
+            node_type *child    = l.child;
+            int        len_node = label_length(child);
+
+            l.node  = child;
+            l.child = NULL;
+            RADIX_TREE_COUNT(nodes_visited, 1);
+
+            if (len_node > len_key || ! head_matches(child, l.key, l.depth, len_node)) {
+                diverged = true;
+                return true;
+            }
 
-    if (parent == m_root)
-        return 1;
+            if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label)
+                l.tails |= len_node > radix_tree_compact_label::inline_size;
+            l.depth += len_node;
+            child->m_children.prefetch();
+            return false;
+        }
 
-    if (parent->m_children.size() > 1)
-        return 1;
+        if (len_key == 0 || l.node->m_children.empty())
+            return true;
 
-    if (parent->m_children.empty()) {
-        grandparent = parent->m_parent;
-        grandparent->m_children.erase(parent->m_key);
-        delete parent;
-    } else {
-        grandparent = parent;
-    }
+        l.child = l.node->m_children.find(l.key[l.depth]);
+        if (l.child == NULL)
+            return true;
 
-    if (grandparent == m_root) {
-        return 1;
-    }
+        __builtin_prefetch(l.child);
+        return false;
+    };
 
-    if (grandparent->m_children.size() == 1) {
-        // merge grandparent with the uncle
-        typename std::map<K, radix_tree_node<K, T, Compare>*>::iterator it;
-        it = grandparent->m_children.begin();
+    lookup      window[batch_window];
+    int         active = 0;
+    std::size_t next   = 0;
 
-        radix_tree_node<K, T, Compare> *uncle = it->second;
+    while (active < batch_window && next < count)
+        start(window[active++], next++);
 
-        if (uncle->m_is_leaf)
-            return 1;
+    while (active > 0) {
+        for (int i = 0; i < active; ) {
+            lookup &l = window[i];
+            bool diverged;
 
-        uncle->m_depth = grandparent->m_depth;
-        uncle->m_key   = radix_join(grandparent->m_key, uncle->m_key);
-        uncle->m_parent = grandparent->m_parent;
+            if (! step(l, diverged)) {
+                i++;
+                continue;
+            }
 
-        grandparent->m_children.erase(it);
+            node_type *node = l.node;
+            if constexpr (node_type::compact_label) {
+                if (l.tails)
+                    node = check_path(node, l.key, diverged);
+            }
 
-        grandparent->m_parent->m_children.erase(grandparent->m_key);
-        grandparent->m_parent->m_children[uncle->m_key] = uncle;
+            results[l.index] = It(matched_node(node, l.key, diverged, longest), &m_root);
 
-        delete grandparent;
+            if (next < count) {
+                start(l, next++);
+                i++;
+            } else {
+                window[i] = window[--active];
+            }
+        }
     }
+}
 
-    return 1;
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename It>
+void radix_tree<K, T, Compare, Alloc>::collect(radix_tree_node<K, T, Compare, Alloc> *node, std::vector<It> &vec) const
+{
+    if (node == NULL)
+        return;
+
+    // node's value goes where iteration puts it among the children
+    bool pending = node->m_has_value;
+
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        if (pending && ! node->m_children.before_value(child)) {
+            vec.push_back(It(node, &m_root));
+            pending = false;
+        }
+        collect(child, vec);
+    });
+
+    if (pending)
+        vec.push_back(It(node, &m_root));
 }
 
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename It>
+std::ranges::subrange<It> radix_tree<K, T, Compare, Alloc>::subtree(radix_tree_node<K, T, Compare, Alloc> *node) const
+{
+    // only an emptied root has neither value nor children
+    if (node == NULL || (! node->m_has_value && node->m_children.empty()))
+        return std::ranges::subrange<It>(It(NULL, &m_root), It(NULL, &m_root));
+
+    return std::ranges::subrange<It>(It(iterator::descend(node), &m_root), It(iterator::ascend(node), &m_root));
+}
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree<K, T, Compare>::append(radix_tree_node<K, T, Compare> *parent, const value_type &val)
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename Range, typename F>
+bool radix_tree<K, T, Compare, Alloc>::visit(const Range &range, F &f)
 {
-    int depth;
-    int len;
-    K   nul = radix_substr(val.first, 0, 0);
-    radix_tree_node<K, T, Compare> *node_c, *node_cc;
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        if (! f(*it))
+            return false;
+    }
+    return true;
+}
 
-    depth = parent->m_depth + radix_length(parent->m_key);
-    len   = radix_length(val.first) - depth;
+// the entry after the erased one is held by a value node, and erasing
+// never frees a node that holds a value, so it can be taken before
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree<K, T, Compare, Alloc>::iterator radix_tree<K, T, Compare, Alloc>::erase(const_iterator it)
+{
+    radix_tree_node<K, T, Compare, Alloc> *node = it.m_pointee;
+    radix_tree_node<K, T, Compare, Alloc> *next = iterator::increment(node);
 
-    if (len == 0) {
-        node_c = new radix_tree_node<K, T, Compare>(val, m_predicate);
+    erase_node(node);
 
-        node_c->m_depth   = depth;
-        node_c->m_parent  = parent;
-        node_c->m_key     = nul;
-        node_c->m_is_leaf = true;
+    return iterator(next, &m_root);
+}
 
-        parent->m_children[nul] = node_c;
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree<K, T, Compare, Alloc>::iterator radix_tree<K, T, Compare, Alloc>::erase(const_iterator first, const_iterator last)
+{
+    iterator it(first.m_pointee, &m_root);
 
-        return node_c;
-    } else {
-        node_c = new radix_tree_node<K, T, Compare>(val, m_predicate);
+    while (it != last)
+        it = erase(it);
 
-        K key_sub = radix_substr(val.first, depth, len);
+    return it;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+bool radix_tree<K, T, Compare, Alloc>::erase(const K &key)
+{
+	if (m_root == NULL)
+		return 0;
+
+	radix_tree_node<K, T, Compare, Alloc> *node;
+    bool diverged;
+    key_view view(key);
 
-        parent->m_children[key_sub] = node_c;
+    RADIX_TREE_COUNT(lookups, 1);
+    node = find_node(view, m_root, 0, &diverged);
 
-        node_c->m_depth  = depth;
-        node_c->m_parent = parent;
-        node_c->m_key    = key_sub;
+    if (! is_exact(node, view, diverged) || ! node->m_has_value)
+        return 0;
 
+    erase_node(node);
 
-		node_cc = new radix_tree_node<K, T, Compare>(val, m_predicate);
-        node_c->m_children[nul] = node_cc;
+    return 1;
+}
 
-        node_cc->m_depth   = depth + len;
-        node_cc->m_parent  = node_c;
-        node_cc->m_key     = nul;
-        node_cc->m_is_leaf = true;
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename P>
+typename radix_tree<K, T, Compare, Alloc>::size_type radix_tree<K, T, Compare, Alloc>::remove_if(P pred)
+{
+    size_type erased = 0;
 
-        return node_cc;
+    for (iterator it = begin(); it != end(); ) {
+        if (pred(it->first)) {
+            it = erase(it);
+            erased++;
+        } else {
+            ++it;
+        }
     }
+
+    return erased;
 }
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree<K, T, Compare>::prepend(radix_tree_node<K, T, Compare> *node, const value_type &val)
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree<K, T, Compare, Alloc>::size_type radix_tree<K, T, Compare, Alloc>::erase_prefix(const key_view &key)
 {
-    int count;
-    int len1, len2;
+    radix_tree_node<K, T, Compare, Alloc> *node = prefix_node(key);
 
-    len1 = radix_length(node->m_key);
-    len2 = radix_length(val.first) - node->m_depth;
+    if (node == NULL)
+        return 0;
 
-    for (count = 0; count < len1 && count < len2; count++) {
-        if (! (node->m_key[count] == val.first[count + node->m_depth]) )
-            break;
+    if (node == m_root) {
+        size_type count = m_size;
+        clear();
+        return count;
     }
 
-    assert(count != 0);
+    size_type count;
+    detach(node, count);
+    destroy(node, true);
 
-    node->m_parent->m_children.erase(node->m_key);
+    return count;
+}
 
-    radix_tree_node<K, T, Compare> *node_a = new radix_tree_node<K, T, Compare>(m_predicate);
+// the subtree is hung below a new root with the label spelling the whole
+// path to it, so that its nodes keep their depths
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree<K, T, Compare, Alloc> radix_tree<K, T, Compare, Alloc>::extract_prefix(const key_view &key)
+{
+    radix_tree_node<K, T, Compare, Alloc> *node = prefix_node(key);
 
-    node_a->m_parent = node->m_parent;
-    node_a->m_key    = radix_substr(node->m_key, 0, count);
-    node_a->m_depth  = node->m_depth;
-    node_a->m_parent->m_children[node_a->m_key] = node_a;
+    if (node == NULL)
+        return radix_tree(m_predicate, m_alloc, NULL, 0);
 
+    if (node == m_root) {
+        size_type count = m_size;
 
-    node->m_depth  += count;
-    node->m_parent  = node_a;
-    node->m_key     = radix_substr(node->m_key, count, len1 - count);
-    node->m_parent->m_children[node->m_key] = node;
+        m_root = NULL;
+        m_size = 0;
+        return radix_tree(m_predicate, m_alloc, node, count);
+    }
 
-    K nul = radix_substr(val.first, 0, 0);
-    if (count == len2) {
-        radix_tree_node<K, T, Compare> *node_b;
+    radix_tree_node<K, T, Compare, Alloc> *leaf = iterator::descend(node);
+    const K &leaf_key = leaf->value().first;
+    radix_tree_node<K, T, Compare, Alloc> *root    = new_root(leaf_key);
+    radix_tree_node<K, T, Compare, Alloc> *parent  = node->m_parent;
+    radix_tree_node<K, T, Compare, Alloc> *partner = merge_partner(node);
+    typename radix_tree_node<K, T, Compare, Alloc>::label_type label;
+    typename radix_tree_node<K, T, Compare, Alloc>::children_type::position position = node->m_position;
+    merged_label joined;
+
+    // everything that may throw comes first: the new label, the parent's
+    // merge and hanging node below root under the new label
+    try {
+        label = make_label(leaf_key, 0, node->m_depth + label_length(node));
+        if (partner != NULL)
+            joined = join(parent, partner);
+
+        std::swap(node->m_key, label);
+        try {
+            root->m_children.insert(node, m_alloc);
+        } catch (...) {
+            std::swap(node->m_key, label);
+            node->m_position = position;
+            throw;
+        }
+    } catch (...) {
+        free_node(root);
+        throw;
+    }
 
-        node_b = new radix_tree_node<K, T, Compare>(val, m_predicate);
+    // the parent finds node by its old label and position
+    std::swap(node->m_key, label);
+    std::swap(node->m_position, position);
+    parent->m_children.erase(node, m_alloc);
+    std::swap(node->m_key, label);
+    node->m_position = position;
 
-        node_b->m_parent  = node_a;
-        node_b->m_key     = nul;
-        node_b->m_depth   = node_a->m_depth + count;
-        node_b->m_is_leaf = true;
-        node_b->m_parent->m_children[nul] = node_b;
+    size_type count = count_entries(node);
+    m_size -= count;
 
-        return node_b;
-    } else {
-        radix_tree_node<K, T, Compare> *node_b, *node_c;
+    node->m_depth  = 0;
+    node->m_parent = root;
 
-        node_b = new radix_tree_node<K, T, Compare>(m_predicate);
+    if (partner != NULL)
+        merge(parent, std::move(joined));
 
-        node_b->m_parent = node_a;
-        node_b->m_depth  = node->m_depth;
-        node_b->m_key    = radix_substr(val.first, node_b->m_depth, len2 - count);
-        node_b->m_parent->m_children[node_b->m_key] = node_b;
+    return radix_tree(m_predicate, m_alloc, root, count);
+}
 
-        node_c = new radix_tree_node<K, T, Compare>(val, m_predicate);
+// unlink the subtree below node, which must not be the root, and merge its
+// parent if that is left with a single child
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::detach(radix_tree_node<K, T, Compare, Alloc> *node, size_type &count)
+{
+    radix_tree_node<K, T, Compare, Alloc> *parent  = node->m_parent;
+    radix_tree_node<K, T, Compare, Alloc> *partner = merge_partner(node);
+    merged_label joined;
 
-        node_c->m_parent  = node_b;
-        node_c->m_depth   = radix_length(val.first);
-        node_c->m_key     = nul;
-        node_c->m_is_leaf = true;
-        node_c->m_parent->m_children[nul] = node_c;
+    if (partner != NULL)
+        joined = join(parent, partner);
 
-        return node_c;
-    }
+    count   = count_entries(node);
+    m_size -= count;
+
+    parent->m_children.erase(node, m_alloc);
+    node->m_parent = NULL;
+
+    if (partner != NULL)
+        merge(parent, std::move(joined));
 }
 
-template <typename K, typename T, typename Compare>
-std::pair<typename radix_tree<K, T, Compare>::iterator, bool> radix_tree<K, T, Compare>::insert(const value_type &val)
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree<K, T, Compare, Alloc>::size_type radix_tree<K, T, Compare, Alloc>::count_entries(const radix_tree_node<K, T, Compare, Alloc> *node)
 {
-    if (m_root == NULL) {
-        K nul = radix_substr(val.first, 0, 0);
+    size_type count = node->m_has_value ? 1 : 0;
 
-        m_root = new radix_tree_node<K, T, Compare>(m_predicate);
-        m_root->m_key = nul;
-    }
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        count += count_entries(child);
+    });
 
+    return count;
+}
 
-    radix_tree_node<K, T, Compare> *node = find_node(val.first, m_root, 0);
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_stats radix_tree<K, T, Compare, Alloc>::stats() const
+{
+    radix_tree_stats stats;
 
-    if (node->m_is_leaf) {
-        return std::pair<iterator, bool>(node, false);
-    } else if (node == m_root) {
-        m_size++;
-        return std::pair<iterator, bool>(append(m_root, val), true);
-    } else {
-        m_size++;
-        int len     = radix_length(node->m_key);
-        K   key_sub = radix_substr(val.first, node->m_depth, len);
+    stats.entries = m_size;
+    if (m_root != NULL)
+        tally(m_root, 0, stats);
 
-        if (key_sub == node->m_key) {
-            return std::pair<iterator, bool>(append(node, val), true);
-        } else {
-            return std::pair<iterator, bool>(prepend(node, val), true);
-        }
+    return stats;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::tally(const radix_tree_node<K, T, Compare, Alloc> *node, std::size_t level, radix_tree_stats &stats)
+{
+    std::size_t fanout = node->m_children.size();
+
+    if (stats.fanout.size() <= fanout)
+        stats.fanout.resize(fanout + 1);
+    if (stats.depth.size() <= level)
+        stats.depth.resize(level + 1);
+
+    stats.nodes++;
+    stats.fanout[fanout]++;
+    stats.depth[level]++;
+    if (fanout == 0)
+        stats.leaf_nodes++;
+    else
+        stats.internal_nodes++;
+    if (node->m_children.kind() >= 0)
+        stats.layouts[node->m_children.kind()]++;
+
+    stats.label_bytes += label_length(node);
+    stats.table_bytes += node->m_children.memory();
+    if constexpr (! radix_tree_node<K, T, Compare, Alloc>::compact_label)
+        stats.key_bytes += radix_heap_bytes(node->m_key);
+
+    if (node->m_has_storage) {
+        stats.value_nodes++;
+        stats.node_bytes += sizeof(radix_tree_value_node<K, T, Compare, Alloc>);
+        if (node->m_has_value)
+            stats.key_bytes += radix_heap_bytes(static_cast<const radix_tree_value_node<K, T, Compare, Alloc>*>(node)->m_value.first);
+    } else {
+        stats.node_bytes += sizeof(radix_tree_node<K, T, Compare, Alloc>);
     }
+
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        tally(child, level + 1, stats);
+    });
 }
 
-template <typename K, typename T, typename Compare>
-typename radix_tree<K, T, Compare>::iterator radix_tree<K, T, Compare>::find(const K &key)
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::compact()
 {
+    static_assert(std::is_nothrow_move_constructible<K>::value && std::is_nothrow_move_constructible<T>::value,
+                  "compact() moves the entries into their new nodes and cannot undo a move that throws");
+
+    typedef radix_tree_node<K, T, Compare, Alloc> node_type;
+
     if (m_root == NULL)
-        return iterator(NULL);
+        return;
+
+    std::vector<placement> order;
+
+    layout(m_root, order);
+
+    bool bulk = radix_tree_bulk_release<Alloc>::exclusive(m_alloc);
+    if (bulk)
+        radix_tree_bulk_release<Alloc>::retire(m_alloc);
+
+    // build the new nodes without values, so that a failure leaves the
+    // entries where they are; with bulk the old nodes then stay in retired
+    // memory until the allocator is released
+    std::vector<node_type*> nodes;
+    std::vector<K>          keys;
 
-    radix_tree_node<K, T, Compare> *node = find_node(key, m_root, 0);
+    keys.reserve(m_size);
+    rebuild(order, nodes, [&](node_type *old) {
+        if (! old->m_has_value)
+            return new_node();
 
-    // if the node is a internal node, return NULL
-    if (! node->m_is_leaf)
-        return iterator(NULL);
+        keys.push_back(old->value().first);
+        return new_value_node(radix_tree_empty_storage());
+    });
 
-    return iterator(node);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < order.size(); i++) {
+        if (order[i].node->m_has_value)
+            static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(nodes[i])->emplace(std::move(keys[k++]), std::move(order[i].node->value().second));
+    }
+
+    node_type *old_root = m_root;
+    m_root = nodes[0];
+
+    if (bulk) {
+        if (! std::is_trivially_destructible<K>::value || ! std::is_trivially_destructible<T>::value)
+            destroy(old_root, false);
+        radix_tree_bulk_release<Alloc>::release_retired(m_alloc);
+    } else {
+        destroy(old_root, true);
+    }
 }
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree<K, T, Compare>::find_node(const K &key, radix_tree_node<K, T, Compare> *node, int depth)
+// new nodes in the shape of order, made by make(old node) one after the
+// other; nodes[i] is the one for order[i]. On failure the nodes made so far
+// are freed.
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename F>
+void radix_tree<K, T, Compare, Alloc>::rebuild(const std::vector<placement> &order, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &nodes, F make)
 {
-    if (node->m_children.empty())
-        return node;
+    nodes.assign(order.size(), NULL);
 
-    typename radix_tree_node<K, T, Compare>::it_child it;
-    int len_key = radix_length(key) - depth;
-
-    for (it = node->m_children.begin(); it != node->m_children.end(); ++it) {
-        if (len_key == 0) {
-            if (it->second->m_is_leaf)
-                return it->second;
-            else
-                continue;
-        }
+    try {
+        for (std::size_t i = 0; i < order.size(); i++) {
+            radix_tree_node<K, T, Compare, Alloc> *old  = order[i].node;
+            radix_tree_node<K, T, Compare, Alloc> *node = make(old);
 
-        if (! it->second->m_is_leaf && key[depth] == it->first[0] ) {
-            int len_node = radix_length(it->first);
-            K   key_sub  = radix_substr(key, depth, len_node);
+            nodes[i] = node;
+            node->m_depth = old->m_depth;
+            node->m_key   = old->m_key;
 
-            if (key_sub == it->first) {
-                return find_node(key, it->second, depth+len_node);
-            } else {
-                return it->second;
+            // a node is linked before the next one is made
+            if (i > 0) {
+                nodes[order[i].parent]->m_children.insert(node, m_alloc);
+                node->m_parent = nodes[order[i].parent];
             }
         }
+    } catch (...) {
+        // only the last node made can be unlinked
+        for (std::size_t i = 1; i < nodes.size() && nodes[i] != NULL; i++) {
+            if (nodes[i]->m_parent == NULL)
+                free_node(nodes[i]);
+        }
+        if (nodes[0] != NULL)
+            destroy(nodes[0], true);
+        throw;
     }
+}
 
-    return node;
+// new nodes for the subtree below root, holding copies of its entries or,
+// with Move, the entries themselves
+template <typename K, typename T, typename Compare, typename Alloc>
+template <bool Move>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::clone(radix_tree_node<K, T, Compare, Alloc> *root)
+{
+    typedef radix_tree_node<K, T, Compare, Alloc> node_type;
+
+    if (root == NULL)
+        return NULL;
+
+    std::vector<placement>  order;
+    std::vector<node_type*> nodes;
+
+    layout(root, order);
+    rebuild(order, nodes, [&](node_type *old) {
+        if (! old->m_has_value)
+            return new_node();
+        if constexpr (Move)
+            return new_value_node(std::move(old->value()));
+        else
+            return new_value_node(std::as_const(old->value()));
+    });
+
+    return nodes[0];
 }
 
-/*
+// the subtree below root in van Emde Boas order, root first
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::layout(radix_tree_node<K, T, Compare, Alloc> *root, std::vector<placement> &order)
+{
+    std::vector<placement> below;
 
-(root)
-|
-|---------------
-|       |      |
-abcde   bcdef  c
-|   |   |      |------
-|   |   $3     |  |  |
-f   ge         d  e  $6
-|   |          |  |
-$1  $2         $4 $5
+    layout(root, static_cast<std::size_t>(-1), height(root), order, below);
+}
 
-find_node():
-  bcdef  -> $3
-  bcdefa -> bcdef
-  c      -> $6
-  cf     -> c
-  abch   -> abcde
-  abc    -> abcde
-  abcde  -> abcde
-  abcdef -> $1
-  abcdeh -> abcde
-  de     -> (root)
+template <typename K, typename T, typename Compare, typename Alloc>
+int radix_tree<K, T, Compare, Alloc>::height(const radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    int h = 0;
 
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        h = std::max(h, height(child));
+    });
 
-(root)
-|
-abcd
-|
-$
+    return h + 1;
+}
 
-(root)
-|
-$
+// appends the subtree below node, cut off height levels down, to order; the
+// nodes just below the cut go to below. Heights passed down are upper
+// bounds, a shallower subtree just ends early.
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::layout(radix_tree_node<K, T, Compare, Alloc> *node, std::size_t parent, int height, std::vector<placement> &order, std::vector<placement> &below)
+{
+    // up to two levels are laid out directly, which spares most calls a
+    // vector for the middle level
+    if (height <= 2) {
+        std::size_t index = order.size();
+
+        order.push_back(placement{ node, parent });
+        node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+            if (height == 1)
+                below.push_back(placement{ child, index });
+            else
+                layout(child, index, 1, order, below);
+        });
+        return;
+    }
+
+    int top = (height + 1) / 2;
+    std::vector<placement> middle;
+
+    layout(node, parent, top, order, middle);
+    for (const placement &p : middle)
+        layout(p.node, p.parent, height - top, order, below);
+}
+
+// drop the value of a node found by a lookup or an iterator and restore
+// path compression around it: a leaf goes away, and a node left with one
+// child, this one or its parent, is merged into that child
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::erase_node(radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    radix_tree_node<K, T, Compare, Alloc> *parent  = node->m_parent;
+    radix_tree_node<K, T, Compare, Alloc> *partner = NULL;
+    merged_label joined;
+
+    // a merge's label is joined first: if that fails, the entry stays
+    if (node != m_root && node->m_children.size() == 1) {
+        joined = join(node, node->m_children.first());
+    } else if (node != m_root && node->m_children.empty()) {
+        partner = merge_partner(node);
+        if (partner != NULL)
+            joined = join(parent, partner);
+    }
+
+    static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(node)->reset();
+
+    m_size--;
+
+    // a node that still branches stays in the tree without a value
+    if (node == m_root || node->m_children.size() > 1)
+        return;
+
+    if (node->m_children.size() == 1) {
+        merge(node, std::move(joined));
+        return;
+    }
+
+    parent->m_children.erase(node, m_alloc);
+    free_node(node);
+
+    if (partner != NULL)
+        merge(parent, std::move(joined));
+}
+
+// cut the subtree below node into about want subtrees to walk in parallel,
+// going down level by level; nodes with a value above the cut are put in
+// singles
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::split(radix_tree_node<K, T, Compare, Alloc> *node, std::size_t want, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &subtrees, std::vector<radix_tree_node<K, T, Compare, Alloc>*> &singles) const
+{
+    subtrees.clear();
+    singles.clear();
+
+    if (node == NULL)
+        return;
+
+    subtrees.push_back(node);
+
+    bool deeper = true;
+    while (deeper && subtrees.size() < want) {
+        std::vector<radix_tree_node<K, T, Compare, Alloc>*> next;
+
+        deeper = false;
+        for (radix_tree_node<K, T, Compare, Alloc> *n : subtrees) {
+            if (n->m_children.empty()) {
+                next.push_back(n);
+                continue;
+            }
+
+            if (n->m_has_value)
+                singles.push_back(n);
+            n->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+                next.push_back(child);
+            });
+            deeper = true;
+        }
+
+        subtrees.swap(next);
+    }
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename F>
+void radix_tree<K, T, Compare, Alloc>::parallel_visit(radix_tree_node<K, T, Compare, Alloc> *node, F &f, unsigned threads)
+{
+    std::vector<radix_tree_node<K, T, Compare, Alloc>*> subtrees, singles;
+
+    split(node, static_cast<std::size_t>(threads) * 8, subtrees, singles);
+
+    radix_tree_run_parallel(threads, subtrees.size() + 1, [&](std::size_t i) {
+        if (i == subtrees.size()) {
+            for (radix_tree_node<K, T, Compare, Alloc> *n : singles)
+                f(n->value());
+            return;
+        }
+
+        for (value_type &val : subtree<iterator>(subtrees[i]))
+            f(val);
+    });
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename P>
+typename radix_tree<K, T, Compare, Alloc>::size_type radix_tree<K, T, Compare, Alloc>::parallel_remove_if(P pred, unsigned threads)
+{
+    std::vector<radix_tree_node<K, T, Compare, Alloc>*> subtrees, singles;
+
+    split(m_root, static_cast<std::size_t>(threads) * 8, subtrees, singles);
+    subtrees.insert(subtrees.end(), singles.begin(), singles.end());
+
+    // a single is its own task; erasing one of the found nodes never frees
+    // another node that holds a value, so the lists stay valid
+    std::vector<std::vector<radix_tree_node<K, T, Compare, Alloc>*> > found(subtrees.size());
+    std::size_t walks = subtrees.size() - singles.size();
+
+    radix_tree_run_parallel(threads, subtrees.size(), [&](std::size_t i) {
+        if (i >= walks) {
+            if (pred(subtrees[i]->value().first))
+                found[i].push_back(subtrees[i]);
+            return;
+        }
+
+        range entries = subtree<iterator>(subtrees[i]);
+        for (iterator it = entries.begin(); it != entries.end(); ++it) {
+            if (pred(it->first))
+                found[i].push_back(it.m_pointee);
+        }
+    });
+
+    size_type erased = 0;
+    for (std::size_t i = 0; i < found.size(); i++) {
+        for (radix_tree_node<K, T, Compare, Alloc> *node : found[i])
+            erase_node(node);
+        erased += found[i].size();
+    }
+
+    return erased;
+}
+
+// the label child gets when node, its parent, is merged into it
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree<K, T, Compare, Alloc>::merged_label radix_tree<K, T, Compare, Alloc>::join(const radix_tree_node<K, T, Compare, Alloc> *node, const radix_tree_node<K, T, Compare, Alloc> *child)
+{
+    merged_label joined;
+
+    joined.label = joined_label(child, node);
+    joined.slot  = radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key_of(joined.label);
+
+    return joined;
+}
+
+// merge a node without value with its only child; nothing here throws
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::merge(radix_tree_node<K, T, Compare, Alloc> *node, merged_label &&joined)
+{
+    radix_tree_node<K, T, Compare, Alloc> *child = node->m_children.first();
+
+    assert(node != m_root && ! node->m_has_value && node->m_children.size() == 1);
+    RADIX_TREE_COUNT(merges, 1);
+
+    child->m_key    = std::move(joined.label);
+    child->m_depth  = node->m_depth;
+    child->m_parent = node->m_parent;
+
+    // the joined label starts like node's: child takes its slot in place
+    child->m_parent->m_children.replace(node, child, std::move(joined.slot));
+
+    free_node(node);
+}
+
+// the child that node's parent is merged into once node is unlinked, or
+// NULL if the parent stays
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::merge_partner(const radix_tree_node<K, T, Compare, Alloc> *node) const
+{
+    radix_tree_node<K, T, Compare, Alloc> *parent = node->m_parent;
+
+    if (parent == m_root || parent->m_has_value || parent->m_children.size() != 2)
+        return NULL;
+
+    radix_tree_node<K, T, Compare, Alloc> *first = parent->m_children.first();
+
+    return first != node ? first : parent->m_children.last();
+}
+
+
+// the key is taken from the freshly built value: the arguments it was built
+// from may have been moved from
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::append(radix_tree_node<K, T, Compare, Alloc> *parent, Args&&... args)
+{
+    int depth;
+    int len;
+    radix_tree_node<K, T, Compare, Alloc> *node_c;
+
+    node_c = new_value_node(std::forward<Args>(args)...);
+
+    const K &key = node_c->value().first;
+
+    depth = parent->m_depth + label_length(parent);
+    len   = radix_length(key) - depth;
+
+    assert(len > 0);
+
+    node_c->m_depth  = depth;
+    node_c->m_parent = parent;
+    set_label(node_c, key, depth, len);
+
+    parent->m_children.insert(node_c, m_alloc);
+
+    return node_c;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::prepend(radix_tree_node<K, T, Compare, Alloc> *node, const key_view &key, Args&&... args)
+{
+    int count;
+    int len1, len2;
+
+    len1 = label_length(node);
+    len2 = radix_length(key) - node->m_depth;
+
+    count = label_mismatch(node, key, node->m_depth, std::min(len1, len2));
+
+    assert(count != 0);
+    RADIX_TREE_COUNT(splits, 1);
+
+    // if the new key ends at the split point, the split node holds its value
+    radix_tree_node<K, T, Compare, Alloc> *node_a;
+    if (count == len2)
+        node_a = new_value_node(std::forward<Args>(args)...);
+    else
+        node_a = new_node();
+
+    node_a->m_parent = node->m_parent;
+    node_a->m_depth  = node->m_depth;
+
+    // whatever may throw happens before the parent changes: node_a's label
+    // and its slot key, then hanging node below node_a, after which node
+    // gets its label back if that fails
+    typename radix_tree_node<K, T, Compare, Alloc>::label_type label;
+    typename radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key slot;
+    typename radix_tree_node<K, T, Compare, Alloc>::children_type::position position = node->m_position;
+
+    try {
+        cut_label(node_a, node, 0, count);
+        slot  = radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key_of(node_a->m_key);
+        label = node->m_key;
+    } catch (...) {
+        free_node(node_a);
+        throw;
+    }
+
+    try {
+        cut_label(node, node, count, len1 - count);
+        node_a->m_children.insert(node, m_alloc);
+    } catch (...) {
+        node->m_key      = std::move(label);
+        node->m_position = position;
+        free_node(node_a);
+        throw;
+    }
+
+    // node_a's label starts like node's: it takes node's slot in place,
+    // which the parent finds by node's old position
+    std::swap(node->m_position, position);
+    node_a->m_parent->m_children.replace(node, node_a, std::move(slot));
+    node->m_position = position;
+    node->m_depth   += count;
+    node->m_parent  = node_a;
+
+    if (count == len2)
+        return node_a;
+
+    return append(node_a, std::forward<Args>(args)...);
+}
+
+// give a node that is already in the tree a value
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::store(radix_tree_node<K, T, Compare, Alloc> *node, Args&&... args)
+{
+    if (node->m_has_storage) {
+        static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(node)->emplace(std::forward<Args>(args)...);
+        return node;
+    }
+
+    // a plain branching node has no room for a value: replace it. The new
+    // node keeps node's label, whose slot key is taken before anything
+    // changes, as taking it may throw
+    typename radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key slot;
+    if (node->m_parent != NULL)
+        slot = radix_tree_node<K, T, Compare, Alloc>::children_type::slot_key_of(node->m_key);
+
+    radix_tree_node<K, T, Compare, Alloc> *node_v = new_value_node(std::forward<Args>(args)...);
+
+    node_v->m_parent = node->m_parent;
+    node_v->m_depth  = node->m_depth;
+    std::swap(node_v->m_key, node->m_key);
+    node_v->m_children.swap(node->m_children);
+    node_v->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        child->m_parent = node_v;
+    });
+
+    if (node == m_root)
+        m_root = node_v;
+    else if (node_v->m_parent != NULL)
+        node_v->m_parent->m_children.replace(node, node_v, std::move(slot));
+
+    free_node(node);
+
+    return node_v;
+}
+
+// a single descent finds where key belongs; the value is constructed from
+// args only if key is not in the tree yet
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::insert_unique(const K &key, Args&&... args)
+{
+    if (m_root == NULL)
+        m_root = new_root(key);
+
+    std::pair<radix_tree_node<K, T, Compare, Alloc>*, bool> ret = place(m_root, key_view(key), std::forward<Args>(args)...);
+
+    if (ret.second)
+        m_size++;
+
+    return std::pair<iterator, bool>(iterator(ret.first, &m_root), ret.second);
+}
+
+// insert below node, whose path has to be a prefix of key; returns the node
+// holding key and whether it was added
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+std::pair<radix_tree_node<K, T, Compare, Alloc>*, bool> radix_tree<K, T, Compare, Alloc>::place(radix_tree_node<K, T, Compare, Alloc> *node, const key_view &key, Args&&... args)
+{
+    bool diverged;
+
+    RADIX_TREE_COUNT(lookups, 1);
+    node = find_node(key, node, node->m_depth + label_length(node), &diverged);
+
+    if (diverged)
+        return std::make_pair(prepend(node, key, std::forward<Args>(args)...), true);
+
+    if (is_exact(node, key, diverged)) {
+        if (node->m_has_value)
+            return std::make_pair(node, false);
+
+        return std::make_pair(store(node, std::forward<Args>(args)...), true);
+    }
+
+    return std::make_pair(append(node, std::forward<Args>(args)...), true);
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <std::input_iterator It>
+typename radix_tree<K, T, Compare, Alloc>::size_type radix_tree<K, T, Compare, Alloc>::bulk_load(It first, It last, unsigned threads)
+{
+    size_type before = m_size;
+
+    if (first == last)
+        return 0;
+
+    if (m_root == NULL)
+        m_root = new_root((*first).first);
+
+    // worker threads share copies of the allocator, which only a stateless
+    // one is known to allow
+    if constexpr (std::random_access_iterator<It> && std::allocator_traits<Alloc>::is_always_equal::value) {
+        if (threads > 1) {
+            load_parallel(first, last, threads);
+            return m_size - before;
+        }
+    }
+
+    load_sorted(m_root, first, last, m_size);
+
+    return m_size - before;
+}
+
+/*
+ * The path from root to the node of the previous entry is the right edge of
+ * the tree built so far. The next entry, if it sorts after, leaves that path
+ * where its common prefix with the previous key ends: it either hangs below
+ * the node ending there, or splits the edge crossing that point. Going up
+ * the path from the previous node finds the spot, and for sorted input no
+ * node is passed twice. An entry that would land on an occupied child slot
+ * is out of order and descends from there like a normal insert.
+ *
+ * root has to be an empty-label node at depth 0. It is replaced if an empty
+ * key is stored in it.
+ */
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename It>
+void radix_tree<K, T, Compare, Alloc>::load_sorted(radix_tree_node<K, T, Compare, Alloc> *&root, It first, It last, size_type &count)
+{
+    typedef radix_tree_node<K, T, Compare, Alloc> node_type;
+
+    node_type *prev = root;
+
+    for (; first != last; ++first) {
+        auto &&val = *first;
+        key_view key(val.first);
+        int len = radix_length(key);
+        int lcp = 0;
+
+        if (prev->m_has_value) {
+            const K &prev_key = prev->value().first;
+            lcp = radix_mismatch(key, 0, prev_key, std::min(len, radix_length(prev_key)));
+        }
+
+        node_type *node = prev;
+        while (node->m_depth > lcp)
+            node = node->m_parent;
+
+        int end = node->m_depth + label_length(node);
+
+        // the key leaves the path where node's label starts
+        if (node->m_depth == lcp && end > lcp) {
+            node = node->m_parent;
+            end  = lcp;
+        }
+
+        std::pair<node_type*, bool> ret;
+
+        if (end > lcp)
+            ret = std::make_pair(prepend(node, key, std::forward<decltype(val)>(val)), true);
+        else if (len == lcp && node->m_has_value)
+            ret = std::make_pair(node, false);
+        else if (len == lcp)
+            ret = std::make_pair(store(node, std::forward<decltype(val)>(val)), true);
+        else if (node->m_children.find(key[lcp]) == NULL)
+            ret = std::make_pair(append(node, std::forward<decltype(val)>(val)), true);
+        else
+            ret = place(node, key, std::forward<decltype(val)>(val));
+
+        if (ret.first->m_parent == NULL)
+            root = ret.first;
+
+        prev = ret.first;
+        if (ret.second)
+            count++;
+    }
+}
+
+// the range is cut into parts at first key element changes; if that leaves
+// every part sorted, each is loaded where it lies. Otherwise the entries are
+// bucketed by their first key element and each bucket sorted and loaded.
+// Either way the parts fill disjoint child slots of the root.
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename It>
+void radix_tree<K, T, Compare, Alloc>::load_parallel(It first, It last, unsigned threads)
+{
+    typedef radix_tree_node<K, T, Compare, Alloc> node_type;
+
+    auto same_head = [](const K &a, const K &b) {
+        return radix_length(a) > 0 && radix_length(b) > 0 && a[0] == b[0];
+    };
+    auto less = [this](const auto &a, const auto &b) {
+        return m_predicate(a.first, b.first);
+    };
+
+    std::vector<It> bounds(1, first);
+    for (unsigned i = 1; i < threads; i++) {
+        It pos = first + (last - first) * i / threads;
+
+        if (pos < bounds.back())
+            pos = bounds.back();
+        while (pos != last && pos != first && same_head((*(pos - 1)).first, (*pos).first))
+            ++pos;
+        if (pos != bounds.back() && pos != last)
+            bounds.push_back(pos);
+    }
+    bounds.push_back(last);
+
+    std::size_t parts = bounds.size() - 1;
+    std::vector<char> sorted(parts, 0);
+
+    radix_tree_run_parallel(threads, parts, [&](std::size_t i) {
+        sorted[i] = std::is_sorted(bounds[i], bounds[i + 1], less) && (i == 0 || less(*(bounds[i] - 1), *bounds[i]));
+    });
+
+    if (std::find(sorted.begin(), sorted.end(), 0) == sorted.end()) {
+        load_parts(parts, threads, [&](std::size_t i, node_type *&root, size_type &count) {
+            root = new_root((*bounds[i]).first);
+            load_sorted(root, bounds[i], bounds[i + 1], count);
+        });
+        return;
+    }
+
+    std::size_t buckets = static_cast<std::size_t>(threads) * 4;
+    auto bucket = [buckets](const K &key) -> std::size_t {
+        return radix_length(key) == 0 ? 0 : std::hash<radix_element_t<K> >()(key[0]) % buckets;
+    };
+
+    // counting sort of entry positions by bucket, counted and scattered
+    // part by part; within a bucket the input order is kept, so that of
+    // duplicate keys the first one still wins
+    std::vector<std::size_t> offsets(parts * buckets, 0);
+    radix_tree_run_parallel(threads, parts, [&](std::size_t i) {
+        for (It it = bounds[i]; it != bounds[i + 1]; ++it)
+            offsets[i * buckets + bucket((*it).first)]++;
+    });
+
+    std::vector<std::size_t> starts(buckets + 1, 0);
+    std::size_t pos = 0;
+    for (std::size_t b = 0; b < buckets; b++) {
+        starts[b] = pos;
+        for (std::size_t i = 0; i < parts; i++) {
+            std::size_t n = offsets[i * buckets + b];
+            offsets[i * buckets + b] = pos;
+            pos += n;
+        }
+    }
+    starts[buckets] = pos;
+
+    std::vector<std::size_t> order(pos);
+    radix_tree_run_parallel(threads, parts, [&](std::size_t i) {
+        for (It it = bounds[i]; it != bounds[i + 1]; ++it)
+            order[offsets[i * buckets + bucket((*it).first)]++] = it - first;
+    });
+
+    load_parts(buckets, threads, [&](std::size_t b, node_type *&root, size_type &count) {
+        auto begin = order.begin() + starts[b];
+        auto end   = order.begin() + starts[b + 1];
+
+        if (begin == end)
+            return;
+
+        std::stable_sort(begin, end, [&](std::size_t x, std::size_t y) { return less(first[x], first[y]); });
+
+        auto entries = std::views::transform(std::ranges::subrange(begin, end), [&](std::size_t x) -> decltype(auto) { return first[x]; });
+        root = new_root(first[*begin].first);
+        load_sorted(root, entries.begin(), entries.end(), count);
+    });
+}
+
+// load(i, root, count) builds part i below a root of its own on one of up to
+// threads threads; the roots are grafted into the tree afterwards, also
+// those of parts that failed half way
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename F>
+void radix_tree<K, T, Compare, Alloc>::load_parts(std::size_t parts, unsigned threads, F load)
+{
+    std::vector<radix_tree_node<K, T, Compare, Alloc>*> roots(parts, NULL);
+    std::vector<size_type> counts(parts, 0);
+    std::exception_ptr error;
+
+    try {
+        radix_tree_run_parallel(threads, parts, [&](std::size_t i) {
+            load(i, roots[i], counts[i]);
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    for (std::size_t i = 0; i < parts; i++) {
+        if (roots[i] != NULL) {
+            m_size += counts[i];
+            graft(roots[i]);
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// move the entries below a separately built root into the tree; a child
+// whose slot in m_root is taken, which only unsorted input causes, has its
+// entries inserted one by one
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::graft(radix_tree_node<K, T, Compare, Alloc> *root)
+{
+    std::vector<radix_tree_node<K, T, Compare, Alloc>*> children;
+
+    root->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        children.push_back(child);
+    });
+
+    for (radix_tree_node<K, T, Compare, Alloc> *child : children) {
+        root->m_children.erase(child, m_alloc);
+
+        if (m_root->m_children.find(child->label_front()) == NULL) {
+            child->m_parent = m_root;
+            m_root->m_children.insert(child, m_alloc);
+        } else {
+            absorb(child);
+        }
+    }
+
+    absorb(root);
+}
+
+// insert the entries of a detached subtree and free it
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::absorb(radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    node->m_children.for_each([&](radix_tree_node<K, T, Compare, Alloc> *child) {
+        absorb(child);
+    });
+
+    if (node->m_has_value) {
+        m_size--;
+        insert_unique(node->value().first, std::move(node->value()));
+    }
+
+    free_node(node);
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::emplace(Args&&... args)
+{
+    // the key is only known once the value exists
+    value_type val(std::forward<Args>(args)...);
+
+    return insert_unique(val.first, std::move(val));
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::try_emplace(const K &key, Args&&... args)
+{
+    return insert_unique(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename... Args>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::try_emplace(K &&key, Args&&... args)
+{
+    return insert_unique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename M>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::insert_or_assign(const K &key, M &&obj)
+{
+    std::pair<iterator, bool> ret = insert_unique(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<M>(obj)));
+
+    if (! ret.second)
+        ret.first->second = std::forward<M>(obj);
+
+    return ret;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename M>
+std::pair<typename radix_tree<K, T, Compare, Alloc>::iterator, bool> radix_tree<K, T, Compare, Alloc>::insert_or_assign(K &&key, M &&obj)
+{
+    std::pair<iterator, bool> ret = insert_unique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<M>(obj)));
+
+    if (! ret.second)
+        ret.first->second = std::forward<M>(obj);
+
+    return ret;
+}
+
+// true if the path to node spells exactly key
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+bool radix_tree<K, T, Compare, Alloc>::is_exact(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool diverged) const
+{
+    return ! diverged && node->m_depth + label_length(node) == radix_length(key);
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+int radix_tree<K, T, Compare, Alloc>::label_length(const radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label)
+        return static_cast<int>(node->m_key.m_len);
+    else
+        return radix_length(node->m_key);
+}
+
+// the first value node below node, whose key spells node's path
+template <typename K, typename T, typename Compare, typename Alloc>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::leaf_below(radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    while (! node->m_has_value) {
+        node = node->m_children.first();
+        RADIX_TREE_COUNT(nodes_visited, 1);
+    }
+
+    return node;
+}
+
+// the bytes of a compact label; a long one is read from the key of a value
+// node below. That walk is not for every step of a descent: descents only
+// compare the head, see head_matches
+template <typename K, typename T, typename Compare, typename Alloc>
+const char* radix_tree<K, T, Compare, Alloc>::label_data(const radix_tree_node<K, T, Compare, Alloc> *node)
+{
+    if (node->m_key.m_len <= radix_tree_compact_label::inline_size)
+        return node->m_key.m_head;
+
+    return leaf_below(const_cast<radix_tree_node<K, T, Compare, Alloc>*>(node))->value().first.data() + node->m_depth;
+}
+
+// length of the common prefix of key[begin, begin + len) and the label
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+int radix_tree<K, T, Compare, Alloc>::label_mismatch(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, int begin, int len)
+{
+    // label_bytes counts the matching elements and the one that differs
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        // the head decides most mismatches without leaving the node
+        int head  = std::min(len, static_cast<int>(radix_tree_compact_label::inline_size));
+        int count = radix_mismatch_bytes(key.data() + begin, node->m_key.m_head, head);
+
+        if (count < head || len == head) {
+            RADIX_TREE_COUNT(label_bytes, count < len ? count + 1 : count);
+            return count;
+        }
+
+        count = head + radix_mismatch_bytes(key.data() + begin + head, label_data(node) + head, len - head);
+        RADIX_TREE_COUNT(label_bytes, count < len ? count + 1 : count);
+        return count;
+    } else {
+        int count = radix_mismatch(key, begin, node->m_key, len);
+
+        RADIX_TREE_COUNT(label_bytes, count < len ? count + 1 : count);
+        return count;
+    }
+}
+
+// whether key[begin, begin + len) matches the label as far as the node
+// holds it: all of a K label, the head of a compact one. As in ART, a
+// descent over compact labels skips their tails and check_path() compares
+// the whole key once where it stops.
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+bool radix_tree<K, T, Compare, Alloc>::head_matches(const radix_tree_node<K, T, Compare, Alloc> *node, const V &key, int begin, int len)
+{
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        int head  = std::min(len, static_cast<int>(radix_tree_compact_label::inline_size));
+        int count = radix_mismatch_bytes(key.data() + begin, node->m_key.m_head, head);
+
+        RADIX_TREE_COUNT(label_bytes, count < head ? count + 1 : count);
+        return count == head;
+    } else {
+        return label_mismatch(node, key, begin, len) == len;
+    }
+}
+
+// a descent that passed label tails unread stopped at node; compare the key
+// with the path, which a value node below spells, and return the node an
+// exact descent stops at: the one whose label holds the first difference
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::check_path(radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool &diverged)
+{
+    int end   = diverged ? node->m_depth : node->m_depth + label_length(node);
+    int count = radix_mismatch_bytes(key.data(), leaf_below(node)->value().first.data(), end);
+
+    RADIX_TREE_COUNT(label_bytes, count < end ? count + 1 : count);
+    if (count == end)
+        return node;
+
+    while (node->m_depth > count)
+        node = node->m_parent;
+
+    diverged = true;
+    return node;
+}
+
+// label = key[begin, begin + len)
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::set_label(radix_tree_node<K, T, Compare, Alloc> *node, const K &key, int begin, int len)
+{
+    node->m_key = make_label(key, begin, len);
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree_node<K, T, Compare, Alloc>::label_type radix_tree<K, T, Compare, Alloc>::make_label(const K &key, int begin, int len)
+{
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        radix_tree_compact_label label;
+
+        label.m_len = static_cast<std::uint32_t>(len);
+        std::memcpy(label.m_head, key.data() + begin, std::min(len, static_cast<int>(radix_tree_compact_label::inline_size)));
+        return label;
+    } else {
+        return radix_substr(key, begin, len);
+    }
+}
+
+// dst's label = src's label[begin, begin + len); dst may be src
+template <typename K, typename T, typename Compare, typename Alloc>
+void radix_tree<K, T, Compare, Alloc>::cut_label(radix_tree_node<K, T, Compare, Alloc> *dst, const radix_tree_node<K, T, Compare, Alloc> *src, int begin, int len)
+{
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        const char *data = label_data(src) + begin;
+
+        dst->m_key.m_len = static_cast<std::uint32_t>(len);
+        std::memmove(dst->m_key.m_head, data, std::min(len, static_cast<int>(radix_tree_compact_label::inline_size)));
+    } else {
+        dst->m_key = radix_substr(src->m_key, begin, len);
+    }
+}
+
+// parent's label + child's label, for child to take
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree_node<K, T, Compare, Alloc>::label_type radix_tree<K, T, Compare, Alloc>::joined_label(const radix_tree_node<K, T, Compare, Alloc> *child, const radix_tree_node<K, T, Compare, Alloc> *parent)
+{
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        const int inline_size = radix_tree_compact_label::inline_size;
+
+        radix_tree_compact_label joined;
+        int len_parent = static_cast<int>(parent->m_key.m_len);
+        int head       = std::min(len_parent, inline_size);
+
+        joined.m_len = parent->m_key.m_len + child->m_key.m_len;
+        std::memcpy(joined.m_head, parent->m_key.m_head, head);
+        std::memcpy(joined.m_head + head, label_data(child), std::min(static_cast<int>(child->m_key.m_len), inline_size - head));
+
+        return joined;
+    } else {
+        return radix_join(parent->m_key, child->m_key);
+    }
+}
+
+// the node a lookup ending at node (as left by find_node) yields: for an
+// exact find, or the nearest one with a value above it for longest_match
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::matched_node(radix_tree_node<K, T, Compare, Alloc> *node, const V &key, bool diverged, bool longest) const
+{
+    if (! longest) {
+        // the key ends inside an edge or at a node without value
+        if (! is_exact(node, key, diverged) || ! node->m_has_value)
+            return NULL;
+        return node;
+    }
+
+    if (diverged)
+        node = node->m_parent;
+
+    while (node != NULL && ! node->m_has_value)
+        node = node->m_parent;
+
+    return node;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc>
+template <typename V>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree<K, T, Compare, Alloc>::find_node(const V &key, radix_tree_node<K, T, Compare, Alloc> *node, int depth, bool *diverged) const
+{
+    bool mismatch = false;
+    bool tails    = false; // passed compact labels whose tails were not read
+    int  len_key  = radix_length(key);
+
+    RADIX_TREE_COUNT(nodes_visited, 1);
+
+    while (depth < len_key && ! node->m_children.empty()) {
+        radix_tree_node<K, T, Compare, Alloc> *child = node->m_children.find(key[depth]);
+        if (child == NULL)
+            break;
+
+        int len_node = label_length(child);
+
+        RADIX_TREE_COUNT(nodes_visited, 1);
+        node = child;
+
+        if (len_node > len_key - depth || ! head_matches(child, key, depth, len_node)) {
+            mismatch = true;
+            break;
+        }
+
+        if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label)
+            tails |= len_node > radix_tree_compact_label::inline_size;
+        depth += len_node;
+    }
+
+    if constexpr (radix_tree_node<K, T, Compare, Alloc>::compact_label) {
+        if (tails)
+            node = check_path(node, key, mismatch);
+    }
+
+    if (diverged != NULL)
+        *diverged = mismatch;
+
+    return node;
+}
+
+/*
+
+(root)
+|
+|---------------
+|       |      |
+abcde   bcdef$3  c$6
+|   |          |------
+|   |          |     |
+f$1 ge$2       d$4   e$5
+
+($n marks a node holding a value)
+
+find_node():
+  bcdef  -> bcdef
+  bcdefa -> bcdef
+  c      -> c
+  cf     -> c
+  abch   -> abcde (diverged)
+  abc    -> abcde (diverged)
+  abcde  -> abcde
+  abcdef -> f
+  abcdeh -> abcde
+  de     -> (root)
+
+
+(root)
+|
+abcd$
+
+(root)$
 
 */
 
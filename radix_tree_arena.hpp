@@ -0,0 +1,229 @@
+#ifndef RADIX_TREE_ARENA_HPP
+#define RADIX_TREE_ARENA_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/*
+ * Slab arena for radix_tree nodes. Blocks are cut from large slabs with a
+ * bump pointer; freed blocks go to a free list per 16-byte size class and are
+ * handed out again by later allocations of the same class, so erase-heavy
+ * workloads do not grow the arena without bound.
+ *
+ * release() returns all slabs at once. A radix_tree that is the only user of
+ * its arena relies on that in clear() and in its destructor instead of
+ * freeing nodes one by one.
+ */
+class radix_tree_arena {
+public:
+    explicit radix_tree_arena(std::size_t slab_size = 64 * 1024);
+    ~radix_tree_arena() { release(); }
+
+    void* allocate(std::size_t bytes, std::size_t align);
+    void deallocate(void *p, std::size_t bytes);
+    void release();
+
+    // sets the slabs in use aside: later allocations come from new slabs,
+    // while the blocks handed out so far stay valid until release_retired().
+    // The free lists are emptied, their blocks may lie in retired slabs.
+    void retire();
+    void release_retired();
+
+    std::size_t slab_count() const { return m_slab_count; }
+    std::size_t bytes_reserved() const { return m_reserved; }
+
+    // number of trees allocating from this arena
+    std::size_t users() const { return m_users; }
+    void attach() { m_users++; }
+    void detach() { assert(m_users > 0); m_users--; }
+
+private:
+    enum { granularity = 16, max_class = 4096 / granularity };
+
+    struct slab {
+        slab       *next;
+        std::size_t size;
+    };
+
+    struct free_block {
+        free_block *next;
+    };
+
+    slab       *m_slabs;
+    slab       *m_retired;
+    char       *m_cur;
+    char       *m_end;
+    std::size_t m_slab_size;
+    std::size_t m_slab_count;
+    std::size_t m_reserved;
+    std::size_t m_users;
+    free_block *m_free[max_class + 1];
+
+    radix_tree_arena(const radix_tree_arena&); // delete
+    radix_tree_arena& operator=(const radix_tree_arena&); // delete
+
+    static std::size_t header_size() { return (sizeof(slab) + granularity - 1) / granularity * granularity; }
+};
+
+inline radix_tree_arena::radix_tree_arena(std::size_t slab_size) :
+    m_slabs(NULL),
+    m_retired(NULL),
+    m_cur(NULL),
+    m_end(NULL),
+    m_slab_size(slab_size),
+    m_slab_count(0),
+    m_reserved(0),
+    m_users(0)
+{
+    for (int i = 0; i <= max_class; i++)
+        m_free[i] = NULL;
+}
+
+inline void* radix_tree_arena::allocate(std::size_t bytes, std::size_t align)
+{
+    assert(align <= granularity);
+    (void)align;
+
+    bytes = (bytes + granularity - 1) / granularity * granularity;
+    if (bytes == 0)
+        bytes = granularity;
+
+    std::size_t size_class = bytes / granularity;
+    if (size_class <= max_class && m_free[size_class] != NULL) {
+        free_block *block = m_free[size_class];
+        m_free[size_class] = block->next;
+        return block;
+    }
+
+    if (m_cur == NULL || static_cast<std::size_t>(m_end - m_cur) < bytes) {
+        std::size_t size = header_size() + (bytes > m_slab_size ? bytes : m_slab_size);
+        slab *s = static_cast<slab*>(std::malloc(size));
+        if (s == NULL)
+            throw std::bad_alloc();
+
+        s->next  = m_slabs;
+        s->size  = size;
+        m_slabs  = s;
+        m_cur    = reinterpret_cast<char*>(s) + header_size();
+        m_end    = reinterpret_cast<char*>(s) + size;
+
+        m_slab_count++;
+        m_reserved += size;
+    }
+
+    void *p = m_cur;
+    m_cur += bytes;
+    return p;
+}
+
+inline void radix_tree_arena::deallocate(void *p, std::size_t bytes)
+{
+    if (p == NULL)
+        return;
+
+    bytes = (bytes + granularity - 1) / granularity * granularity;
+    if (bytes == 0)
+        bytes = granularity;
+
+    // oversized blocks are only reclaimed by release()
+    std::size_t size_class = bytes / granularity;
+    if (size_class > max_class)
+        return;
+
+    free_block *block = static_cast<free_block*>(p);
+    block->next = m_free[size_class];
+    m_free[size_class] = block;
+}
+
+inline void radix_tree_arena::release()
+{
+    retire();
+    release_retired();
+}
+
+inline void radix_tree_arena::retire()
+{
+    while (m_slabs != NULL) {
+        slab *next = m_slabs->next;
+        m_slabs->next = m_retired;
+        m_retired = m_slabs;
+        m_slabs = next;
+    }
+
+    for (int i = 0; i <= max_class; i++)
+        m_free[i] = NULL;
+
+    m_cur = NULL;
+    m_end = NULL;
+}
+
+inline void radix_tree_arena::release_retired()
+{
+    while (m_retired != NULL) {
+        slab *next = m_retired->next;
+
+        m_slab_count--;
+        m_reserved -= m_retired->size;
+        std::free(m_retired);
+        m_retired = next;
+    }
+
+    // blocks freed since retire() may lie in the slabs just dropped
+    for (int i = 0; i <= max_class; i++)
+        m_free[i] = NULL;
+}
+
+// std-compatible allocator drawing from a radix_tree_arena
+template <typename T>
+class radix_tree_arena_allocator {
+public:
+    typedef T value_type;
+
+    radix_tree_arena_allocator(radix_tree_arena &arena) : m_arena(&arena) { }
+    template <typename U>
+    radix_tree_arena_allocator(const radix_tree_arena_allocator<U> &other) : m_arena(other.arena()) { }
+
+    T* allocate(std::size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *p, std::size_t n) { m_arena->deallocate(p, n * sizeof(T)); }
+
+    radix_tree_arena* arena() const { return m_arena; }
+
+    template <typename U>
+    bool operator== (const radix_tree_arena_allocator<U> &rhs) const { return m_arena == rhs.arena(); }
+    template <typename U>
+    bool operator!= (const radix_tree_arena_allocator<U> &rhs) const { return m_arena != rhs.arena(); }
+
+private:
+    radix_tree_arena *m_arena;
+};
+
+/*
+ * Lets radix_tree drop all its nodes at once when the allocator supports it.
+ * exclusive() tells whether the tree is the only user of the memory behind
+ * the allocator, release() then frees all of it. retire() and
+ * release_retired() do the same in two steps, for radix_tree::compact() to
+ * move the nodes in between.
+ */
+template <typename Alloc>
+struct radix_tree_bulk_release {
+    static void attach(const Alloc&) { }
+    static void detach(const Alloc&) { }
+    static bool exclusive(const Alloc&) { return false; }
+    static void release(const Alloc&) { }
+    static void retire(const Alloc&) { }
+    static void release_retired(const Alloc&) { }
+};
+
+template <typename T>
+struct radix_tree_bulk_release<radix_tree_arena_allocator<T> > {
+    static void attach(const radix_tree_arena_allocator<T> &alloc) { alloc.arena()->attach(); }
+    static void detach(const radix_tree_arena_allocator<T> &alloc) { alloc.arena()->detach(); }
+    static bool exclusive(const radix_tree_arena_allocator<T> &alloc) { return alloc.arena()->users() == 1; }
+    static void release(const radix_tree_arena_allocator<T> &alloc) { alloc.arena()->release(); }
+    static void retire(const radix_tree_arena_allocator<T> &alloc) { alloc.arena()->retire(); }
+    static void release_retired(const radix_tree_arena_allocator<T> &alloc) { alloc.arena()->release_retired(); }
+};
+
+#endif // RADIX_TREE_ARENA_HPP
@@ -0,0 +1,884 @@
+#ifndef RADIX_TREE_CHILDREN_HPP
+#define RADIX_TREE_CHILDREN_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "radix_tree_counters.hpp"
+
+// type of a single key element, i.e. what key[i] yields
+template <typename K>
+using radix_element_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<const K&>()[0])> >;
+
+// bytes a key holds on the heap beyond sizeof(K); specialise for key types
+// that allocate
+template <typename K>
+std::size_t radix_heap_bytes(const K&) { return 0; }
+
+inline std::size_t radix_heap_bytes(const std::string &key)
+{
+    const char *data = key.data();
+    const char *self = reinterpret_cast<const char*>(&key);
+
+    // short strings are kept inside the object
+    return (data >= self && data < self + sizeof(key)) ? 0 : key.capacity() + 1;
+}
+
+// whether std::less on K orders elements as their unsigned bytes do;
+// strings compare through char_traits, which treats char as unsigned
+template <typename K>
+struct radix_unsigned_order : std::is_unsigned<radix_element_t<K> > { };
+
+template <typename C, typename A>
+struct radix_unsigned_order<std::basic_string<C, std::char_traits<C>, A> > : std::true_type { };
+
+// Children of a node are stored in adaptive ART-style arrays (Node4/16/48/256)
+// when they can be addressed by one byte and ordering them by that byte agrees
+// with Compare. Otherwise they live in a std::map ordered by Compare.
+// Specialise this trait to force either layout for a key type.
+template <typename K, typename Compare>
+struct radix_tree_adaptive_nodes : std::integral_constant<bool,
+    std::is_integral<radix_element_t<K> >::value &&
+    !std::is_same<radix_element_t<K>, bool>::value &&
+    sizeof(radix_element_t<K>) == 1 &&
+    radix_unsigned_order<K>::value &&
+    (std::is_same<Compare, std::less<K> >::value || std::is_same<Compare, std::less<void> >::value)> { };
+
+/*
+ * Byte-indexed child table that switches between four layouts as it grows
+ * and shrinks:
+ *
+ *   node4   - up to 4 sorted keys, linear search
+ *   node16  - up to 16 sorted keys, searched with one SSE2 compare
+ *   node48  - 256 one-byte slots pointing into 48 children
+ *   node256 - 256 child pointers indexed directly
+ *
+ * An empty table allocates nothing. The table does not keep its allocator;
+ * every call that may allocate or free takes it, and the owner has to call
+ * release() before the table goes away, or abandon() when the allocator's
+ * memory is about to be dropped in bulk.
+ */
+template <typename Node, typename Alloc = std::allocator<Node> >
+class radix_tree_art_index {
+public:
+    enum kind_t { node4 = 0, node16 = 1, node48 = 2, node256 = 3 };
+
+    radix_tree_art_index() : m_body(NULL) { }
+    ~radix_tree_art_index() { assert(m_body == NULL); }
+
+    Node* find(unsigned char byte) const;
+    void insert(unsigned char byte, Node *child, const Alloc &alloc);
+    void erase(unsigned char byte, const Alloc &alloc);
+    void replace(unsigned char byte, Node *child);
+    void release(const Alloc &alloc);
+    void abandon() { m_body = NULL; }
+
+    Node* first() const;
+    Node* last() const;
+    Node* next(unsigned char byte) const;
+    Node* prev(unsigned char byte) const;
+
+    std::size_t size() const { return m_body == NULL ? 0 : m_body->count; }
+    int kind() const { return m_body == NULL ? -1 : m_body->kind; }
+    std::size_t memory() const;
+    void swap(radix_tree_art_index &other) { std::swap(m_body, other.m_body); }
+    void prefetch() const { __builtin_prefetch(m_body); }
+
+    template <typename F> void for_each(F f) const;
+
+private:
+    struct header {
+        std::uint8_t  kind;
+        std::uint16_t count;
+    };
+
+    template <int N>
+    struct sorted_body : header {
+        std::uint8_t keys[N];
+        Node        *children[N];
+    };
+
+    typedef sorted_body<4>  body4;
+    typedef sorted_body<16> body16;
+
+    struct body48 : header {
+        std::uint8_t slots[256]; // 0 = empty, otherwise index + 1 into children
+        Node        *children[48];
+    };
+
+    struct body256 : header {
+        Node *children[256];
+    };
+
+    header *m_body;
+
+    radix_tree_art_index(const radix_tree_art_index&); // delete
+    radix_tree_art_index& operator=(const radix_tree_art_index&); // delete
+
+    void relayout(int kind, const Alloc &alloc);
+
+    template <typename Body> static Body* create(const Alloc &alloc);
+    template <typename Body> static void dispose(header *body, const Alloc &alloc);
+
+    template <int N> static int sorted_lower_bound(const sorted_body<N> *body, unsigned char byte);
+    template <int N> static void sorted_insert(sorted_body<N> *body, unsigned char byte, Node *child);
+    template <int N> static void sorted_erase(sorted_body<N> *body, unsigned char byte);
+    template <int N> static header* fill_sorted(sorted_body<N> *body, const unsigned char *keys, Node *const *children, int count);
+};
+
+template <typename Node, typename Alloc>
+template <typename Body>
+Body* radix_tree_art_index<Node, Alloc>::create(const Alloc &alloc)
+{
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Body> body_alloc(alloc);
+
+    Body *body = body_alloc.allocate(1);
+    RADIX_TREE_COUNT(allocations, 1);
+    ::new (static_cast<void*>(body)) Body();
+    return body;
+}
+
+template <typename Node, typename Alloc>
+template <typename Body>
+void radix_tree_art_index<Node, Alloc>::dispose(header *body, const Alloc &alloc)
+{
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Body> body_alloc(alloc);
+
+    static_cast<Body*>(body)->~Body();
+    body_alloc.deallocate(static_cast<Body*>(body), 1);
+}
+
+template <typename Node, typename Alloc>
+void radix_tree_art_index<Node, Alloc>::release(const Alloc &alloc)
+{
+    if (m_body == NULL)
+        return;
+
+    switch (m_body->kind) {
+    case node4:   dispose<body4>(m_body, alloc);   break;
+    case node16:  dispose<body16>(m_body, alloc);  break;
+    case node48:  dispose<body48>(m_body, alloc);  break;
+    case node256: dispose<body256>(m_body, alloc); break;
+    }
+    m_body = NULL;
+}
+
+template <typename Node, typename Alloc>
+template <int N>
+int radix_tree_art_index<Node, Alloc>::sorted_lower_bound(const sorted_body<N> *body, unsigned char byte)
+{
+    int i = 0;
+    while (i < body->count && body->keys[i] < byte)
+        i++;
+    return i;
+}
+
+template <typename Node, typename Alloc>
+template <int N>
+void radix_tree_art_index<Node, Alloc>::sorted_insert(sorted_body<N> *body, unsigned char byte, Node *child)
+{
+    int pos = sorted_lower_bound(body, byte);
+
+    if (pos < body->count && body->keys[pos] == byte) {
+        body->children[pos] = child;
+        return;
+    }
+
+    for (int i = body->count; i > pos; i--) {
+        body->keys[i]     = body->keys[i - 1];
+        body->children[i] = body->children[i - 1];
+    }
+    body->keys[pos]     = byte;
+    body->children[pos] = child;
+    body->count++;
+}
+
+template <typename Node, typename Alloc>
+template <int N>
+void radix_tree_art_index<Node, Alloc>::sorted_erase(sorted_body<N> *body, unsigned char byte)
+{
+    int pos = sorted_lower_bound(body, byte);
+
+    if (pos == body->count || body->keys[pos] != byte)
+        return;
+
+    for (int i = pos + 1; i < body->count; i++) {
+        body->keys[i - 1]     = body->keys[i];
+        body->children[i - 1] = body->children[i];
+    }
+    body->count--;
+}
+
+template <typename Node, typename Alloc>
+template <int N>
+typename radix_tree_art_index<Node, Alloc>::header* radix_tree_art_index<Node, Alloc>::fill_sorted(sorted_body<N> *body, const unsigned char *keys, Node *const *children, int count)
+{
+    for (int i = 0; i < count; i++) {
+        body->keys[i]     = keys[i];
+        body->children[i] = children[i];
+    }
+    return body;
+}
+
+// bytes of the current body
+template <typename Node, typename Alloc>
+std::size_t radix_tree_art_index<Node, Alloc>::memory() const
+{
+    switch (kind()) {
+    case node4:   return sizeof(body4);
+    case node16:  return sizeof(body16);
+    case node48:  return sizeof(body48);
+    case node256: return sizeof(body256);
+    default:      return 0;
+    }
+}
+
+template <typename Node, typename Alloc>
+Node* radix_tree_art_index<Node, Alloc>::find(unsigned char byte) const
+{
+    if (m_body == NULL)
+        return NULL;
+
+    switch (m_body->kind) {
+    case node4: {
+        const body4 *body = static_cast<const body4*>(m_body);
+        for (int i = 0; i < body->count; i++) {
+            if (body->keys[i] == byte)
+                return body->children[i];
+        }
+        return NULL;
+    }
+    case node16: {
+        const body16 *body = static_cast<const body16*>(m_body);
+#if defined(__SSE2__)
+        __m128i cmp  = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(byte)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(body->keys)));
+        int     mask = _mm_movemask_epi8(cmp) & ((1 << body->count) - 1);
+        return mask == 0 ? NULL : body->children[__builtin_ctz(mask)];
+#else
+        for (int i = 0; i < body->count; i++) {
+            if (body->keys[i] == byte)
+                return body->children[i];
+        }
+        return NULL;
+#endif
+    }
+    case node48: {
+        const body48 *body = static_cast<const body48*>(m_body);
+        return body->slots[byte] == 0 ? NULL : body->children[body->slots[byte] - 1];
+    }
+    default:
+        return static_cast<const body256*>(m_body)->children[byte];
+    }
+}
+
+template <typename Node, typename Alloc>
+template <typename F>
+void radix_tree_art_index<Node, Alloc>::for_each(F f) const
+{
+    if (m_body == NULL)
+        return;
+
+    switch (m_body->kind) {
+    case node4: {
+        const body4 *body = static_cast<const body4*>(m_body);
+        for (int i = 0; i < body->count; i++)
+            f(body->keys[i], body->children[i]);
+        break;
+    }
+    case node16: {
+        const body16 *body = static_cast<const body16*>(m_body);
+        for (int i = 0; i < body->count; i++)
+            f(body->keys[i], body->children[i]);
+        break;
+    }
+    case node48: {
+        const body48 *body = static_cast<const body48*>(m_body);
+        for (int i = 0; i < 256; i++) {
+            if (body->slots[i] != 0)
+                f(static_cast<unsigned char>(i), body->children[body->slots[i] - 1]);
+        }
+        break;
+    }
+    default: {
+        const body256 *body = static_cast<const body256*>(m_body);
+        for (int i = 0; i < 256; i++) {
+            if (body->children[i] != NULL)
+                f(static_cast<unsigned char>(i), body->children[i]);
+        }
+        break;
+    }
+    }
+}
+
+// the new body is filled before the old one goes, so that a failed
+// allocation leaves the table as it was
+template <typename Node, typename Alloc>
+void radix_tree_art_index<Node, Alloc>::relayout(int kind, const Alloc &alloc)
+{
+    unsigned char keys[256];
+    Node         *children[256];
+    int           count = 0;
+    header       *fresh;
+
+    for_each([&](unsigned char byte, Node *child) {
+        keys[count]     = byte;
+        children[count] = child;
+        count++;
+    });
+
+    switch (kind) {
+    case node4:
+        fresh = fill_sorted(create<body4>(alloc), keys, children, count);
+        break;
+    case node16:
+        fresh = fill_sorted(create<body16>(alloc), keys, children, count);
+        break;
+    case node48: {
+        body48 *body = create<body48>(alloc);
+        for (int i = 0; i < count; i++) {
+            body->slots[keys[i]] = static_cast<std::uint8_t>(i + 1);
+            body->children[i]    = children[i];
+        }
+        fresh = body;
+        break;
+    }
+    default: {
+        body256 *body = create<body256>(alloc);
+        for (int i = 0; i < count; i++)
+            body->children[keys[i]] = children[i];
+        fresh = body;
+        break;
+    }
+    }
+
+    release(alloc);
+    m_body = fresh;
+    m_body->kind  = static_cast<std::uint8_t>(kind);
+    m_body->count = static_cast<std::uint16_t>(count);
+}
+
+template <typename Node, typename Alloc>
+void radix_tree_art_index<Node, Alloc>::insert(unsigned char byte, Node *child, const Alloc &alloc)
+{
+    if (m_body == NULL) {
+        m_body = create<body4>(alloc);
+        m_body->kind  = node4;
+        m_body->count = 0;
+    }
+
+    switch (m_body->kind) {
+    case node4: {
+        body4 *body = static_cast<body4*>(m_body);
+        if (body->count == 4 && find(byte) == NULL) {
+            relayout(node16, alloc);
+            insert(byte, child, alloc);
+            return;
+        }
+        sorted_insert(body, byte, child);
+        break;
+    }
+    case node16: {
+        body16 *body = static_cast<body16*>(m_body);
+        if (body->count == 16 && find(byte) == NULL) {
+            relayout(node48, alloc);
+            insert(byte, child, alloc);
+            return;
+        }
+        sorted_insert(body, byte, child);
+        break;
+    }
+    case node48: {
+        body48 *body = static_cast<body48*>(m_body);
+        if (body->slots[byte] != 0) {
+            body->children[body->slots[byte] - 1] = child;
+            return;
+        }
+        if (body->count == 48) {
+            relayout(node256, alloc);
+            insert(byte, child, alloc);
+            return;
+        }
+        int slot = 0;
+        while (body->children[slot] != NULL)
+            slot++;
+        body->children[slot] = child;
+        body->slots[byte]    = static_cast<std::uint8_t>(slot + 1);
+        body->count++;
+        break;
+    }
+    default: {
+        body256 *body = static_cast<body256*>(m_body);
+        if (body->children[byte] == NULL)
+            body->count++;
+        body->children[byte] = child;
+        break;
+    }
+    }
+}
+
+// point the existing entry for byte at child; never allocates nor relayouts
+template <typename Node, typename Alloc>
+void radix_tree_art_index<Node, Alloc>::replace(unsigned char byte, Node *child)
+{
+    assert(find(byte) != NULL);
+
+    switch (m_body->kind) {
+    case node4: {
+        body4 *body = static_cast<body4*>(m_body);
+        body->children[sorted_lower_bound(body, byte)] = child;
+        break;
+    }
+    case node16: {
+        body16 *body = static_cast<body16*>(m_body);
+        body->children[sorted_lower_bound(body, byte)] = child;
+        break;
+    }
+    case node48: {
+        body48 *body = static_cast<body48*>(m_body);
+        body->children[body->slots[byte] - 1] = child;
+        break;
+    }
+    default:
+        static_cast<body256*>(m_body)->children[byte] = child;
+        break;
+    }
+}
+
+template <typename Node, typename Alloc>
+void radix_tree_art_index<Node, Alloc>::erase(unsigned char byte, const Alloc &alloc)
+{
+    if (m_body == NULL)
+        return;
+
+    // shrink thresholds leave some slack so that a node oscillating around
+    // a boundary does not relayout on every insert/erase
+    int shrink = -1;
+
+    switch (m_body->kind) {
+    case node4:
+        sorted_erase(static_cast<body4*>(m_body), byte);
+        if (m_body->count == 0)
+            release(alloc);
+        break;
+    case node16:
+        sorted_erase(static_cast<body16*>(m_body), byte);
+        if (m_body->count <= 3)
+            shrink = node4;
+        break;
+    case node48: {
+        body48 *body = static_cast<body48*>(m_body);
+        if (body->slots[byte] == 0)
+            return;
+        body->children[body->slots[byte] - 1] = NULL;
+        body->slots[byte] = 0;
+        body->count--;
+        if (body->count <= 12)
+            shrink = node16;
+        break;
+    }
+    default: {
+        body256 *body = static_cast<body256*>(m_body);
+        if (body->children[byte] == NULL)
+            return;
+        body->children[byte] = NULL;
+        body->count--;
+        if (body->count <= 40)
+            shrink = node48;
+        break;
+    }
+    }
+
+    // erase does not fail: without memory for the smaller body the larger
+    // one stays
+    if (shrink >= 0) {
+        try {
+            relayout(shrink, alloc);
+        } catch (...) {
+        }
+    }
+}
+
+template <typename Node, typename Alloc>
+Node* radix_tree_art_index<Node, Alloc>::first() const
+{
+    if (m_body == NULL)
+        return NULL;
+
+    Node *result = NULL;
+    switch (m_body->kind) {
+    case node4:
+        return static_cast<const body4*>(m_body)->children[0];
+    case node16:
+        return static_cast<const body16*>(m_body)->children[0];
+    case node48: {
+        const body48 *body = static_cast<const body48*>(m_body);
+        for (int i = 0; i < 256 && result == NULL; i++) {
+            if (body->slots[i] != 0)
+                result = body->children[body->slots[i] - 1];
+        }
+        return result;
+    }
+    default: {
+        const body256 *body = static_cast<const body256*>(m_body);
+        for (int i = 0; i < 256 && result == NULL; i++)
+            result = body->children[i];
+        return result;
+    }
+    }
+}
+
+template <typename Node, typename Alloc>
+Node* radix_tree_art_index<Node, Alloc>::next(unsigned char byte) const
+{
+    if (m_body == NULL)
+        return NULL;
+
+    switch (m_body->kind) {
+    case node4: {
+        const body4 *body = static_cast<const body4*>(m_body);
+        int pos = sorted_lower_bound(body, byte);
+        if (pos < body->count && body->keys[pos] == byte)
+            pos++;
+        return pos < body->count ? body->children[pos] : NULL;
+    }
+    case node16: {
+        const body16 *body = static_cast<const body16*>(m_body);
+        int pos = sorted_lower_bound(body, byte);
+        if (pos < body->count && body->keys[pos] == byte)
+            pos++;
+        return pos < body->count ? body->children[pos] : NULL;
+    }
+    case node48: {
+        const body48 *body = static_cast<const body48*>(m_body);
+        for (int i = byte + 1; i < 256; i++) {
+            if (body->slots[i] != 0)
+                return body->children[body->slots[i] - 1];
+        }
+        return NULL;
+    }
+    default: {
+        const body256 *body = static_cast<const body256*>(m_body);
+        for (int i = byte + 1; i < 256; i++) {
+            if (body->children[i] != NULL)
+                return body->children[i];
+        }
+        return NULL;
+    }
+    }
+}
+
+template <typename Node, typename Alloc>
+Node* radix_tree_art_index<Node, Alloc>::last() const
+{
+    if (m_body == NULL)
+        return NULL;
+
+    switch (m_body->kind) {
+    case node4:
+        return static_cast<const body4*>(m_body)->children[m_body->count - 1];
+    case node16:
+        return static_cast<const body16*>(m_body)->children[m_body->count - 1];
+    default: {
+        Node *result = find(0xff);
+        return result != NULL ? result : prev(0xff);
+    }
+    }
+}
+
+template <typename Node, typename Alloc>
+Node* radix_tree_art_index<Node, Alloc>::prev(unsigned char byte) const
+{
+    if (m_body == NULL)
+        return NULL;
+
+    switch (m_body->kind) {
+    case node4: {
+        const body4 *body = static_cast<const body4*>(m_body);
+        int pos = sorted_lower_bound(body, byte);
+        return pos > 0 ? body->children[pos - 1] : NULL;
+    }
+    case node16: {
+        const body16 *body = static_cast<const body16*>(m_body);
+        int pos = sorted_lower_bound(body, byte);
+        return pos > 0 ? body->children[pos - 1] : NULL;
+    }
+    case node48: {
+        const body48 *body = static_cast<const body48*>(m_body);
+        for (int i = byte - 1; i >= 0; i--) {
+            if (body->slots[i] != 0)
+                return body->children[body->slots[i] - 1];
+        }
+        return NULL;
+    }
+    default: {
+        const body256 *body = static_cast<const body256*>(m_body);
+        for (int i = byte - 1; i >= 0; i--) {
+            if (body->children[i] != NULL)
+                return body->children[i];
+        }
+        return NULL;
+    }
+    }
+}
+
+/*
+ * Children of a radix_tree_node, addressed by the first element of their key.
+ *
+ * position is what a child has to remember about its place among its
+ * siblings so that next() and prev() do not have to search for it.
+ *
+ * The node's own value sorts among its children as an empty label would
+ * under Compare: before_value() tells the children that come ahead of it,
+ * which are always a leading run, and after_value() is the first child
+ * behind it.
+ */
+template <typename K, typename Node, typename Compare, typename Alloc,
+          bool Adaptive = radix_tree_adaptive_nodes<K, Compare>::value>
+class radix_tree_children;
+
+// generic layout: std::map ordered by Compare plus a sorted element index
+template <typename K, typename Node, typename Compare, typename Alloc>
+class radix_tree_children<K, Node, Compare, Alloc, false> {
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<const K, Node*> > map_allocator;
+    typedef std::map<K, Node*, Compare, map_allocator> map_type;
+
+public:
+    typedef radix_element_t<K> element_type;
+    typedef typename map_type::const_iterator position;
+
+    radix_tree_children(const Compare &pred, const Alloc &alloc) : m_map(pred, alloc), m_index(alloc) { }
+
+    Node* find(const element_type &elem) const;
+    void insert(Node *child, const Alloc &alloc);
+    void erase(Node *child, const Alloc &alloc);
+    // the map key replace() files a child with this label under; taking it
+    // is the part that may throw, so callers do that before they change
+    // anything
+    typedef K slot_key;
+    static slot_key slot_key_of(const K &label) { return label; }
+    void replace(Node *old_child, Node *new_child, slot_key key);
+    void release(const Alloc&) { }
+    void abandon() { }
+    void swap(radix_tree_children &other) { m_map.swap(other.m_map); m_index.swap(other.m_index); }
+    // hint that find() is about to be called
+    void prefetch() const { __builtin_prefetch(m_index.data()); }
+
+    Node* first() const { return m_map.empty() ? NULL : m_map.begin()->second; }
+    Node* last() const { return m_map.empty() ? NULL : m_map.rbegin()->second; }
+    Node* next(const Node *child) const;
+    Node* prev(const Node *child) const;
+
+    bool before_value(const Node *child) const;
+    bool value_first() const { return m_map.empty() || ! before_value(m_map.begin()->second); }
+    Node* after_value() const;
+
+    std::size_t size() const { return m_map.size(); }
+    bool empty() const { return m_map.empty(); }
+    int kind() const { return -1; }
+    std::size_t memory() const;
+
+    template <typename F> void for_each(F f) const;
+
+private:
+    typedef std::pair<element_type, Node*> index_entry;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<index_entry> index_allocator;
+
+    // an empty label sorts first under these
+    static constexpr bool less_order = std::is_same<Compare, std::less<K> >::value || std::is_same<Compare, std::less<void> >::value;
+
+    map_type m_map;
+    std::vector<index_entry, index_allocator>  m_index;
+
+    typename std::vector<index_entry, index_allocator>::const_iterator lower_bound(const element_type &elem) const
+    {
+        return std::lower_bound(m_index.begin(), m_index.end(), elem,
+                                [](const index_entry &entry, const element_type &e) { return entry.first < e; });
+    }
+};
+
+// a map node is the entry plus three links and the colour, as in the usual
+// red-black tree; a copy of the child's label lives in it as the map key
+template <typename K, typename Node, typename Compare, typename Alloc>
+std::size_t radix_tree_children<K, Node, Compare, Alloc, false>::memory() const
+{
+    std::size_t bytes = m_index.capacity() * sizeof(index_entry);
+
+    for (auto it = m_map.begin(); it != m_map.end(); ++it)
+        bytes += sizeof(typename map_type::value_type) + 4 * sizeof(void*) + radix_heap_bytes(it->first);
+
+    return bytes;
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+Node* radix_tree_children<K, Node, Compare, Alloc, false>::find(const element_type &elem) const
+{
+    auto it = lower_bound(elem);
+
+    if (it == m_index.end() || !(it->first == elem))
+        return NULL;
+
+    return it->second;
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+void radix_tree_children<K, Node, Compare, Alloc, false>::insert(Node *child, const Alloc&)
+{
+    child->m_position = m_map.insert_or_assign(child->m_key, child).first;
+
+    const element_type &elem = child->label_front();
+    auto it = m_index.begin() + (lower_bound(elem) - m_index.begin());
+
+    if (it != m_index.end() && it->first == elem)
+        it->second = child;
+    else
+        m_index.insert(it, index_entry(elem, child));
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+void radix_tree_children<K, Node, Compare, Alloc, false>::erase(Node *child, const Alloc&)
+{
+    m_map.erase(child->m_position);
+
+    auto it = lower_bound(child->label_front());
+    if (it != m_index.end() && it->second == child)
+        m_index.erase(it);
+}
+
+// new_child takes the place of old_child, whose label starts with the same
+// element; the map node is reused and key moved into it
+template <typename K, typename Node, typename Compare, typename Alloc>
+void radix_tree_children<K, Node, Compare, Alloc, false>::replace(Node *old_child, Node *new_child, slot_key key)
+{
+    auto handle = m_map.extract(old_child->m_position);
+    handle.key()    = std::move(key);
+    handle.mapped() = new_child;
+    new_child->m_position = m_map.insert(std::move(handle)).position;
+
+    auto it = m_index.begin() + (lower_bound(new_child->label_front()) - m_index.begin());
+    assert(it != m_index.end() && it->second == old_child);
+    it->second = new_child;
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+Node* radix_tree_children<K, Node, Compare, Alloc, false>::next(const Node *child) const
+{
+    position it = std::next(child->m_position);
+
+    return it == m_map.end() ? NULL : it->second;
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+Node* radix_tree_children<K, Node, Compare, Alloc, false>::prev(const Node *child) const
+{
+    position it = child->m_position;
+
+    return it == m_map.begin() ? NULL : std::prev(it)->second;
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+bool radix_tree_children<K, Node, Compare, Alloc, false>::before_value(const Node *child) const
+{
+    if constexpr (less_order)
+        return false;
+    else
+        return m_map.key_comp()(child->m_position->first, K());
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+Node* radix_tree_children<K, Node, Compare, Alloc, false>::after_value() const
+{
+    if constexpr (less_order) {
+        return first();
+    } else {
+        position it = m_map.lower_bound(K());
+
+        return it == m_map.end() ? NULL : it->second;
+    }
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+template <typename F>
+void radix_tree_children<K, Node, Compare, Alloc, false>::for_each(F f) const
+{
+    for (auto it = m_map.begin(); it != m_map.end(); ++it)
+        f(it->second);
+}
+
+// adaptive layout: children addressed by their first byte
+template <typename K, typename Node, typename Compare, typename Alloc>
+class radix_tree_children<K, Node, Compare, Alloc, true> {
+public:
+    typedef radix_element_t<K> element_type;
+    struct position { }; // the first byte of the child's key is enough
+
+    radix_tree_children(const Compare&, const Alloc&) { }
+
+    Node* find(const element_type &elem) const { return m_index.find(static_cast<unsigned char>(elem)); }
+    void insert(Node *child, const Alloc &alloc) { m_index.insert(static_cast<unsigned char>(child->label_front()), child, alloc); }
+    void erase(Node *child, const Alloc &alloc);
+    // the byte is all a slot needs
+    struct slot_key { };
+    template <typename Label>
+    static slot_key slot_key_of(const Label&) { return slot_key(); }
+    void replace(Node *old_child, Node *new_child, slot_key);
+    void release(const Alloc &alloc) { m_index.release(alloc); }
+    void abandon() { m_index.abandon(); }
+    void swap(radix_tree_children &other) { m_index.swap(other.m_index); }
+    void prefetch() const { m_index.prefetch(); }
+
+    Node* first() const { return m_index.first(); }
+    Node* last() const { return m_index.last(); }
+    Node* next(const Node *child) const { return m_index.next(static_cast<unsigned char>(child->label_front())); }
+    Node* prev(const Node *child) const { return m_index.prev(static_cast<unsigned char>(child->label_front())); }
+
+    // byte order puts the empty label first
+    bool before_value(const Node*) const { return false; }
+    bool value_first() const { return true; }
+    Node* after_value() const { return m_index.first(); }
+
+    std::size_t size() const { return m_index.size(); }
+    bool empty() const { return m_index.size() == 0; }
+    int kind() const { return m_index.kind(); }
+    std::size_t memory() const { return m_index.memory(); }
+
+    template <typename F> void for_each(F f) const { m_index.for_each([&](unsigned char, Node *child) { f(child); }); }
+
+private:
+    radix_tree_art_index<Node, Alloc> m_index;
+};
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+void radix_tree_children<K, Node, Compare, Alloc, true>::erase(Node *child, const Alloc &alloc)
+{
+    unsigned char byte = static_cast<unsigned char>(child->label_front());
+
+    if (m_index.find(byte) == child)
+        m_index.erase(byte, alloc);
+}
+
+template <typename K, typename Node, typename Compare, typename Alloc>
+void radix_tree_children<K, Node, Compare, Alloc, true>::replace(Node *old_child, Node *new_child, slot_key)
+{
+    unsigned char byte = static_cast<unsigned char>(new_child->label_front());
+
+    assert(m_index.find(byte) == old_child);
+    (void)old_child;
+    m_index.replace(byte, new_child);
+}
+
+#endif // RADIX_TREE_CHILDREN_HPP
@@ -0,0 +1,64 @@
+#ifndef RADIX_TREE_COUNTERS_HPP
+#define RADIX_TREE_COUNTERS_HPP
+
+#include <cstdint>
+
+/*
+ * Hot-path event counters. The tree reports events through
+ * RADIX_TREE_COUNT(event, n), which expands to nothing unless
+ * RADIX_TREE_INSTRUMENT is defined before the first radix_tree header is
+ * included; then it adds n to the calling thread's radix_tree_counters.
+ * A program may also define RADIX_TREE_COUNT itself to send the events
+ * elsewhere; it is called with the bare name of a radix_tree_counters::event.
+ *
+ * Counters are per thread, so lookups running in parallel do not share a
+ * cache line. Read them around the operations to sample, e.g.
+ *
+ *   radix_tree_counters before = radix_tree_thread_counters();
+ *   tree.find(key);
+ *   radix_tree_counters cost = radix_tree_thread_counters() - before;
+ */
+struct radix_tree_counters {
+    enum event {
+        lookups,        // descents from the root: find, longest_match, insert, ...
+        nodes_visited,  // nodes entered by a descent or passed by an iterator
+        label_bytes,    // label elements compared with a key
+        splits,         // edges split by an insert
+        merges,         // nodes merged into their only child by an erase
+        allocations,    // nodes and adaptive child tables allocated
+        iterator_steps, // iterator increments and decrements
+        events
+    };
+
+    std::uint64_t count[events] = { };
+
+    std::uint64_t operator[] (event e) const { return count[e]; }
+
+    radix_tree_counters operator- (const radix_tree_counters &other) const
+    {
+        radix_tree_counters diff;
+        for (int i = 0; i < events; i++)
+            diff.count[i] = count[i] - other.count[i];
+        return diff;
+    }
+};
+
+#if defined(RADIX_TREE_INSTRUMENT)
+
+inline radix_tree_counters& radix_tree_thread_counters()
+{
+    static thread_local radix_tree_counters counters;
+    return counters;
+}
+
+#ifndef RADIX_TREE_COUNT
+#define RADIX_TREE_COUNT(e, n) (radix_tree_thread_counters().count[radix_tree_counters::e] += (n))
+#endif
+
+#endif // RADIX_TREE_INSTRUMENT
+
+#ifndef RADIX_TREE_COUNT
+#define RADIX_TREE_COUNT(e, n) ((void)0)
+#endif
+
+#endif // RADIX_TREE_COUNTERS_HPP
@@ -0,0 +1,125 @@
+#ifndef RADIX_TREE_EPOCH_HPP
+#define RADIX_TREE_EPOCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Epoch-based reclamation for concurrent_radix_tree.
+ *
+ * A reader announces the global epoch in a slot before it loads the root and
+ * clears the slot when it is done. The writer tags every node it unlinks with
+ * the epoch current at the time and then advances the epoch; a node may be
+ * freed once every announced epoch is newer than its tag, because a reader
+ * that announced a newer epoch loaded the root after the node was unlinked.
+ *
+ * Readers never block and never write shared state other than their own
+ * slot. retire(), reclaim() and pending() must be called by one writer at a
+ * time.
+ */
+class radix_tree_epoch {
+public:
+    radix_tree_epoch() : m_epoch(1) {
+        for (std::size_t i = 0; i < slot_count; i++)
+            m_slots[i].epoch.store(0, std::memory_order_relaxed);
+    }
+    ~radix_tree_epoch() { reclaim_all(); }
+
+    // announces a read section; returns the slot to pass to leave()
+    std::size_t enter();
+    void leave(std::size_t slot) { m_slots[slot].epoch.store(0, std::memory_order_release); }
+
+    void retire(void *p, void (*deleter)(void*)) { m_retired.push_back(retired(m_epoch.load(std::memory_order_relaxed), p, deleter)); }
+    void advance() { m_epoch.fetch_add(1, std::memory_order_seq_cst); }
+    void reclaim();
+    void reclaim_all();
+
+    std::size_t pending() const { return m_retired.size(); }
+
+    // RAII read section
+    class guard {
+    public:
+        explicit guard(radix_tree_epoch &epoch) : m_epoch(epoch), m_slot(epoch.enter()) { }
+        ~guard() { m_epoch.leave(m_slot); }
+
+    private:
+        radix_tree_epoch &m_epoch;
+        std::size_t       m_slot;
+
+        guard(const guard&); // delete
+        guard& operator=(const guard&); // delete
+    };
+
+private:
+    enum { slot_count = 128 };
+
+    // one cache line per slot so that readers do not share lines
+    struct alignas(64) slot {
+        std::atomic<std::uint64_t> epoch;
+    };
+
+    struct retired {
+        retired(std::uint64_t e, void *p, void (*d)(void*)) : epoch(e), ptr(p), deleter(d) { }
+
+        std::uint64_t epoch;
+        void         *ptr;
+        void        (*deleter)(void*);
+    };
+
+    std::atomic<std::uint64_t> m_epoch;
+    slot                       m_slots[slot_count];
+    std::vector<retired>       m_retired;
+
+    radix_tree_epoch(const radix_tree_epoch&); // delete
+    radix_tree_epoch& operator=(const radix_tree_epoch&); // delete
+};
+
+inline std::size_t radix_tree_epoch::enter()
+{
+    std::size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+
+    for (;;) {
+        std::uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        std::uint64_t idle  = 0;
+
+        // seq_cst orders the announcement before the reader's root load
+        if (m_slots[slot].epoch.compare_exchange_weak(idle, epoch, std::memory_order_seq_cst))
+            return slot;
+
+        slot = (slot + 1) % slot_count;
+    }
+}
+
+inline void radix_tree_epoch::reclaim()
+{
+    std::uint64_t oldest = m_epoch.load(std::memory_order_seq_cst);
+
+    for (std::size_t i = 0; i < slot_count; i++) {
+        std::uint64_t epoch = m_slots[i].epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_retired.size(); i++) {
+        if (m_retired[i].epoch < oldest)
+            m_retired[i].deleter(m_retired[i].ptr);
+        else
+            m_retired[kept++] = m_retired[i];
+    }
+    m_retired.resize(kept, retired(0, NULL, NULL));
+}
+
+inline void radix_tree_epoch::reclaim_all()
+{
+    for (std::size_t i = 0; i < m_retired.size(); i++)
+        m_retired[i].deleter(m_retired[i].ptr);
+    m_retired.clear();
+}
+
+#endif // RADIX_TREE_EPOCH_HPP
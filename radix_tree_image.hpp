@@ -0,0 +1,548 @@
+#ifndef RADIX_TREE_IMAGE_HPP
+#define RADIX_TREE_IMAGE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "radix_tree.hpp"
+
+/*
+ * On-disk image of a radix_tree<std::string, T> that is used in place.
+ *
+ * The file holds arrays linked by indices and offsets only, so it can be
+ * mapped at any address: the nodes in pre-order, the child tables, one
+ * entry per stored key, the values and the key bytes. Edge labels are not
+ * stored; a label points into the key of the first entry below its node,
+ * which spells the same bytes. Because the nodes are in pre-order, the
+ * entries of a subtree are one run [first, last) of the entry array, so
+ * iteration and prefix ranges are plain index ranges.
+ *
+ * T must be trivially copyable. The file is in host byte order.
+ */
+struct radix_tree_image_header {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t value_size;
+    std::uint64_t size;         // entries
+    std::uint64_t node_count;
+    std::uint64_t child_count;
+    std::uint64_t nodes;        // section offsets from the start of the file
+    std::uint64_t children;
+    std::uint64_t child_bytes;
+    std::uint64_t entries;
+    std::uint64_t values;
+    std::uint64_t keys;
+    std::uint64_t file_size;
+};
+
+struct radix_tree_image_node {
+    std::uint64_t label;        // offset of the label in the key bytes
+    std::uint32_t label_len;
+    std::uint32_t depth;        // key length above the label
+    std::uint32_t children;     // first slot in the child tables
+    std::uint16_t child_count;
+    std::uint16_t has_value;    // the node's own entry is entries[first]
+    std::uint32_t first;        // entries of the subtree
+    std::uint32_t last;
+};
+
+struct radix_tree_image_entry {
+    std::uint64_t key;          // offset in the key bytes
+    std::uint64_t key_len;
+};
+
+template <typename T> class radix_tree_image;
+
+template <typename T>
+class radix_tree_image_it {
+    friend class radix_tree_image<T>;
+
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = std::pair<std::string_view, const T&>;
+    using difference_type   = std::ptrdiff_t;
+    using reference         = value_type;
+
+    // operator-> has to return something that holds the pair
+    struct pointer {
+        value_type pair;
+        const value_type* operator-> () const { return &pair; }
+    };
+
+    radix_tree_image_it() : m_image(NULL), m_index(0) { }
+
+    reference operator* () const { return m_image->entry(m_index); }
+    pointer operator-> () const { return pointer{ m_image->entry(m_index) }; }
+    reference operator[] (difference_type n) const { return m_image->entry(m_index + n); }
+
+    radix_tree_image_it& operator++ () { m_index++; return *this; }
+    radix_tree_image_it operator++ (int) { radix_tree_image_it it = *this; m_index++; return it; }
+    radix_tree_image_it& operator-- () { m_index--; return *this; }
+    radix_tree_image_it operator-- (int) { radix_tree_image_it it = *this; m_index--; return it; }
+    radix_tree_image_it& operator+= (difference_type n) { m_index += n; return *this; }
+    radix_tree_image_it& operator-= (difference_type n) { m_index -= n; return *this; }
+    radix_tree_image_it operator+ (difference_type n) const { return radix_tree_image_it(m_image, m_index + n); }
+    radix_tree_image_it operator- (difference_type n) const { return radix_tree_image_it(m_image, m_index - n); }
+    friend radix_tree_image_it operator+ (difference_type n, const radix_tree_image_it &it) { return it + n; }
+    difference_type operator- (const radix_tree_image_it &rhs) const { return static_cast<difference_type>(m_index) - static_cast<difference_type>(rhs.m_index); }
+
+    bool operator== (const radix_tree_image_it &rhs) const { return m_index == rhs.m_index; }
+    auto operator<=> (const radix_tree_image_it &rhs) const { return m_index <=> rhs.m_index; }
+
+private:
+    const radix_tree_image<T> *m_image;
+    std::size_t                m_index;
+
+    radix_tree_image_it(const radix_tree_image<T> *image, std::size_t index) : m_image(image), m_index(index) { }
+};
+
+template <typename T>
+class radix_tree_image {
+    static_assert(std::is_trivially_copyable<T>::value, "radix_tree_image stores values as raw bytes");
+
+    friend class radix_tree_image_it<T>;
+
+public:
+    typedef std::string_view                      key_type;
+    typedef T                                     mapped_type;
+    typedef std::size_t                           size_type;
+    typedef radix_tree_image_it<T>                const_iterator;
+    typedef const_iterator                        iterator;
+    typedef std::ranges::subrange<const_iterator> const_range;
+
+    radix_tree_image() : m_base(NULL), m_length(0), m_header(NULL), m_nodes(NULL), m_children(NULL), m_child_bytes(NULL), m_entries(NULL), m_values(NULL), m_keys(NULL) { }
+    ~radix_tree_image() { close(); }
+
+    // writes tree to path; false if the file could not be written. The image
+    // is written next to path and renamed over it, so processes that have
+    // the old one mapped keep reading it unchanged
+    template <typename Compare, typename Alloc>
+    static bool save(const radix_tree<std::string, T, Compare, Alloc> &tree, const char *path);
+
+    // maps an image read-only; false if it is missing or malformed. Every
+    // index and offset in the file is checked against the section it points
+    // into, so lookups in an image that opened stay inside the mapping
+    bool open(const char *path);
+    void close();
+    bool is_open() const { return m_base != NULL; }
+
+    size_type size() const { return m_header == NULL ? 0 : m_header->size; }
+    bool empty() const { return size() == 0; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    const_iterator find(std::string_view key) const;
+    const_iterator longest_match(std::string_view key) const;
+    const_range prefix_range(std::string_view key) const;
+    void prefix_match(std::string_view key, std::vector<const_iterator> &vec) const;
+
+private:
+    static const std::uint32_t version = 1;
+    static const char          magic[8];
+
+    void                                *m_base;
+    std::size_t                          m_length;
+    const radix_tree_image_header       *m_header;
+    const radix_tree_image_node         *m_nodes;
+    const std::uint32_t                 *m_children;
+    const unsigned char                 *m_child_bytes;
+    const radix_tree_image_entry        *m_entries;
+    const T                             *m_values;
+    const char                          *m_keys;
+
+    radix_tree_image(const radix_tree_image&); // delete
+    radix_tree_image& operator=(const radix_tree_image&); // delete
+
+    std::pair<std::string_view, const T&> entry(std::size_t index) const {
+        const radix_tree_image_entry &e = m_entries[index];
+        return std::pair<std::string_view, const T&>(std::string_view(m_keys + e.key, e.key_len), m_values[index]);
+    }
+
+    bool valid_sections() const;
+    bool valid_nodes() const;
+    bool valid_entries() const;
+
+    const radix_tree_image_node* child(const radix_tree_image_node *node, unsigned char byte) const;
+    const radix_tree_image_node* descend(std::string_view key, const radix_tree_image_node **partial, const radix_tree_image_node **best) const;
+
+    template <typename Compare, typename Alloc>
+    struct writer;
+};
+
+template <typename T>
+const char radix_tree_image<T>::magic[8] = { 'R', 'D', 'X', 'I', 'M', 'A', 'G', 'E' };
+
+// builds the sections in memory in one pre-order walk of the tree
+template <typename T>
+template <typename Compare, typename Alloc>
+struct radix_tree_image<T>::writer {
+    typedef radix_tree<std::string, T, Compare, Alloc>      tree_type;
+    typedef radix_tree_node<std::string, T, Compare, Alloc> node_type;
+
+    std::vector<radix_tree_image_node>  nodes;
+    std::vector<std::uint32_t>          children;
+    std::vector<unsigned char>          child_bytes;
+    std::vector<radix_tree_image_entry> entries;
+    std::vector<T>                      values;
+    std::string                         keys;
+
+    std::uint32_t walk(node_type *node) {
+        std::uint32_t index = static_cast<std::uint32_t>(nodes.size());
+        radix_tree_image_node rec = radix_tree_image_node();
+
+        nodes.push_back(rec);
+
+        rec.depth = static_cast<std::uint32_t>(node->m_depth);
+        rec.label_len = static_cast<std::uint32_t>(tree_type::label_length(node));
+        rec.first = static_cast<std::uint32_t>(entries.size());
+
+        if (node->m_has_value) {
+            const std::string &key = node->value().first;
+            entries.push_back(radix_tree_image_entry{ keys.size(), key.size() });
+            values.push_back(node->value().second);
+            keys += key;
+            rec.has_value = 1;
+        }
+
+        // the image is in byte order whatever the tree's Compare is
+        std::vector<node_type*> below;
+        node->m_children.for_each([&](node_type *c) { below.push_back(c); });
+        std::sort(below.begin(), below.end(), [](node_type *a, node_type *b) {
+            return static_cast<unsigned char>(a->label_front()) < static_cast<unsigned char>(b->label_front());
+        });
+
+        rec.children    = static_cast<std::uint32_t>(children.size());
+        rec.child_count = static_cast<std::uint16_t>(below.size());
+        children.resize(children.size() + below.size());
+        child_bytes.resize(child_bytes.size() + below.size());
+
+        for (std::size_t i = 0; i < below.size(); i++) {
+            child_bytes[rec.children + i] = static_cast<unsigned char>(below[i]->label_front());
+            children[rec.children + i]    = walk(below[i]);
+        }
+
+        rec.last = static_cast<std::uint32_t>(entries.size());
+        if (rec.first < rec.last)
+            rec.label = entries[rec.first].key + rec.depth;
+
+        nodes[index] = rec;
+        return index;
+    }
+};
+
+static inline std::uint64_t radix_tree_image_align(std::uint64_t offset)
+{
+    return (offset + 63) & ~std::uint64_t(63);
+}
+
+// whether count items of size bytes starting at offset end by limit,
+// without overflowing
+static inline bool radix_tree_image_fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t limit)
+{
+    return offset <= limit && count <= (limit - offset) / size;
+}
+
+template <typename T>
+template <typename Compare, typename Alloc>
+bool radix_tree_image<T>::save(const radix_tree<std::string, T, Compare, Alloc> &tree, const char *path)
+{
+    writer<Compare, Alloc> w;
+
+    if (tree.m_root != NULL)
+        w.walk(tree.m_root);
+    else
+        w.nodes.push_back(radix_tree_image_node());
+
+    radix_tree_image_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version     = version;
+    header.value_size  = sizeof(T);
+    header.size        = w.entries.size();
+    header.node_count  = w.nodes.size();
+    header.child_count = w.children.size();
+
+    // every section starts on a cache line
+    header.nodes       = radix_tree_image_align(sizeof(header));
+    header.children    = radix_tree_image_align(header.nodes + w.nodes.size() * sizeof(radix_tree_image_node));
+    header.child_bytes = radix_tree_image_align(header.children + w.children.size() * sizeof(std::uint32_t));
+    header.entries     = radix_tree_image_align(header.child_bytes + w.child_bytes.size());
+    header.values      = radix_tree_image_align(header.entries + w.entries.size() * sizeof(radix_tree_image_entry));
+    header.keys        = radix_tree_image_align(header.values + w.values.size() * sizeof(T));
+    header.file_size   = header.keys + w.keys.size();
+
+    std::string tmp = std::string(path) + ".tmp";
+
+    std::FILE *file = std::fopen(tmp.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    std::uint64_t written = 0;
+    bool ok = true;
+
+    auto put = [&](std::uint64_t offset, const void *data, std::size_t len) {
+        static const char zeros[64] = { 0 };
+        ok = ok && std::fwrite(zeros, 1, offset - written, file) == offset - written;
+        ok = ok && (len == 0 || std::fwrite(data, 1, len, file) == len);
+        written = offset + len;
+    };
+
+    put(0, &header, sizeof(header));
+    put(header.nodes, w.nodes.data(), w.nodes.size() * sizeof(radix_tree_image_node));
+    put(header.children, w.children.data(), w.children.size() * sizeof(std::uint32_t));
+    put(header.child_bytes, w.child_bytes.data(), w.child_bytes.size());
+    put(header.entries, w.entries.data(), w.entries.size() * sizeof(radix_tree_image_entry));
+    put(header.values, w.values.data(), w.values.size() * sizeof(T));
+    put(header.keys, w.keys.data(), w.keys.size());
+
+    // the data has to be on disk before the rename makes it the image
+    ok = ok && std::fflush(file) == 0 && ::fsync(fileno(file)) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    ok = ok && std::rename(tmp.c_str(), path) == 0;
+
+    if (! ok)
+        std::remove(tmp.c_str());
+    return ok;
+}
+
+template <typename T>
+bool radix_tree_image<T>::open(const char *path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(radix_tree_image_header))) {
+        ::close(fd);
+        return false;
+    }
+
+    void *base = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    m_base   = base;
+    m_length = st.st_size;
+
+    const char *p = static_cast<const char*>(base);
+
+    m_header = static_cast<const radix_tree_image_header*>(base);
+    if (! valid_sections()) {
+        close();
+        return false;
+    }
+
+    m_nodes       = reinterpret_cast<const radix_tree_image_node*>(p + m_header->nodes);
+    m_children    = reinterpret_cast<const std::uint32_t*>(p + m_header->children);
+    m_child_bytes = reinterpret_cast<const unsigned char*>(p + m_header->child_bytes);
+    m_entries     = reinterpret_cast<const radix_tree_image_entry*>(p + m_header->entries);
+    m_values      = reinterpret_cast<const T*>(p + m_header->values);
+    m_keys        = p + m_header->keys;
+
+    if (! valid_nodes() || ! valid_entries()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// the sections are in order, aligned for their types and inside the file
+template <typename T>
+bool radix_tree_image<T>::valid_sections() const
+{
+    const radix_tree_image_header *h = m_header;
+
+    return std::memcmp(h->magic, magic, sizeof(magic)) == 0 && h->version == version &&
+        h->value_size == sizeof(T) && h->file_size == m_length &&
+        // node and entry indices are 32 bits wide
+        h->node_count > 0 && h->node_count <= UINT32_MAX && h->size <= UINT32_MAX && h->child_count <= UINT32_MAX &&
+        h->nodes % alignof(radix_tree_image_node) == 0 && h->children % alignof(std::uint32_t) == 0 &&
+        h->entries % alignof(radix_tree_image_entry) == 0 && h->values % alignof(T) == 0 &&
+        h->nodes >= sizeof(radix_tree_image_header) &&
+        radix_tree_image_fits(h->nodes, h->node_count, sizeof(radix_tree_image_node), h->children) &&
+        radix_tree_image_fits(h->children, h->child_count, sizeof(std::uint32_t), h->child_bytes) &&
+        radix_tree_image_fits(h->child_bytes, h->child_count, 1, h->entries) &&
+        radix_tree_image_fits(h->entries, h->size, sizeof(radix_tree_image_entry), h->values) &&
+        radix_tree_image_fits(h->values, h->size, sizeof(T), h->keys) &&
+        h->keys <= h->file_size;
+}
+
+// child tables and entry runs stay inside their sections, labels inside the
+// key bytes, and children come after their parent in pre-order, so that a
+// descent cannot loop
+template <typename T>
+bool radix_tree_image<T>::valid_nodes() const
+{
+    const std::uint64_t key_bytes = m_header->file_size - m_header->keys;
+
+    for (std::uint64_t i = 0; i < m_header->node_count; i++) {
+        const radix_tree_image_node &node = m_nodes[i];
+
+        if (node.children > m_header->child_count || node.child_count > m_header->child_count - node.children)
+            return false;
+        if (node.first > node.last || node.last > m_header->size || (node.has_value && node.first == node.last))
+            return false;
+        if (node.label_len > 0 && ! radix_tree_image_fits(node.label, node.label_len, 1, key_bytes))
+            return false;
+
+        for (std::uint32_t c = node.children; c < node.children + node.child_count; c++) {
+            if (m_children[c] <= i || m_children[c] >= m_header->node_count || m_nodes[m_children[c]].label_len == 0)
+                return false;
+            if (c > node.children && m_child_bytes[c - 1] >= m_child_bytes[c])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+bool radix_tree_image<T>::valid_entries() const
+{
+    const std::uint64_t key_bytes = m_header->file_size - m_header->keys;
+
+    for (std::uint64_t i = 0; i < m_header->size; i++) {
+        if (! radix_tree_image_fits(m_entries[i].key, m_entries[i].key_len, 1, key_bytes))
+            return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+void radix_tree_image<T>::close()
+{
+    if (m_base != NULL)
+        ::munmap(m_base, m_length);
+
+    m_base   = NULL;
+    m_length = 0;
+    m_header = NULL;
+}
+
+template <typename T>
+const radix_tree_image_node* radix_tree_image<T>::child(const radix_tree_image_node *node, unsigned char byte) const
+{
+    const unsigned char *first = m_child_bytes + node->children;
+    const unsigned char *last  = first + node->child_count;
+    const unsigned char *it    = std::lower_bound(first, last, byte);
+
+    if (it == last || *it != byte)
+        return NULL;
+
+    return m_nodes + m_children[node->children + (it - first)];
+}
+
+// Follows key down as far as whole labels match and returns the last node
+// reached. If key ends inside the next label and matches it that far, that
+// child goes to *partial. *best is the deepest node with a value passed.
+template <typename T>
+const radix_tree_image_node* radix_tree_image<T>::descend(std::string_view key, const radix_tree_image_node **partial, const radix_tree_image_node **best) const
+{
+    const radix_tree_image_node *node = m_nodes;
+    std::size_t depth = 0;
+
+    *partial = NULL;
+    *best    = node->has_value ? node : NULL;
+
+    while (depth < key.size()) {
+        const radix_tree_image_node *next = child(node, static_cast<unsigned char>(key[depth]));
+        if (next == NULL)
+            break;
+
+        std::size_t len  = next->label_len;
+        std::size_t rest = std::min(len, key.size() - depth);
+
+        if (static_cast<std::size_t>(radix_mismatch_bytes(key.data() + depth, m_keys + next->label, static_cast<int>(rest))) != rest)
+            break;
+
+        if (rest < len) {
+            *partial = next;
+            break;
+        }
+
+        node   = next;
+        depth += len;
+        if (node->has_value)
+            *best = node;
+    }
+
+    return node;
+}
+
+template <typename T>
+typename radix_tree_image<T>::const_iterator radix_tree_image<T>::find(std::string_view key) const
+{
+    if (m_header == NULL)
+        return end();
+
+    const radix_tree_image_node *partial, *best;
+    const radix_tree_image_node *node = descend(key, &partial, &best);
+
+    if (node->depth + node->label_len != key.size() || ! node->has_value)
+        return end();
+
+    return const_iterator(this, node->first);
+}
+
+template <typename T>
+typename radix_tree_image<T>::const_iterator radix_tree_image<T>::longest_match(std::string_view key) const
+{
+    if (m_header == NULL)
+        return end();
+
+    const radix_tree_image_node *partial, *best;
+    descend(key, &partial, &best);
+
+    return best == NULL ? end() : const_iterator(this, best->first);
+}
+
+template <typename T>
+typename radix_tree_image<T>::const_range radix_tree_image<T>::prefix_range(std::string_view key) const
+{
+    if (m_header == NULL)
+        return const_range(end(), end());
+
+    const radix_tree_image_node *partial, *best;
+    const radix_tree_image_node *node = descend(key, &partial, &best);
+
+    if (partial != NULL)
+        node = partial;
+    else if (node->depth + node->label_len != key.size())
+        return const_range(end(), end());
+
+    return const_range(const_iterator(this, node->first), const_iterator(this, node->last));
+}
+
+template <typename T>
+void radix_tree_image<T>::prefix_match(std::string_view key, std::vector<const_iterator> &vec) const
+{
+    const_range range = prefix_range(key);
+
+    vec.clear();
+    for (const_iterator it = range.begin(); it != range.end(); ++it)
+        vec.push_back(it);
+}
+
+#endif // RADIX_TREE_IMAGE_HPP
@@ -2,101 +2,205 @@
 #define RADIX_TREE_IT
 
 #include <cassert>
+#include <functional>
 #include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "radix_tree_counters.hpp"
 
 // forward declaration
-template <typename K, typename T, class Compare = std::less<K> > class radix_tree;
-template <typename K, typename T, class Compare = std::less<K> > class radix_tree_node;
+template <typename K, typename T, class Compare = std::less<K>, class Alloc = std::allocator<std::pair<const K, T> > > class radix_tree;
+template <typename K, typename T, class Compare = std::less<K>, class Alloc = std::allocator<std::pair<const K, T> > > class radix_tree_node;
 
-template <typename K, typename T, class Compare = std::less<K> >
+// Const selects const_iterator, which yields const references to the entries
+template <typename K, typename T, class Compare = std::less<K>, class Alloc = std::allocator<std::pair<const K, T> >, bool Const = false>
 class radix_tree_it {
-    friend class radix_tree<K, T, Compare>;
+    friend class radix_tree<K, T, Compare, Alloc>;
+    template <typename, typename, typename, typename, bool> friend class radix_tree_it;
 
 public:
     // iterator aliases required by std::iterator_traits
-    using iterator_category = std::forward_iterator_tag;
+    using iterator_category = std::bidirectional_iterator_tag;
     using value_type        = std::pair<const K, T>;
     using difference_type   = std::ptrdiff_t;
-    using pointer           = value_type*;
-    using reference         = value_type&;
-
-    radix_tree_it() : m_pointee(0) { }
-    radix_tree_it(const radix_tree_it& r) : m_pointee(r.m_pointee) { }
-    radix_tree_it& operator=(const radix_tree_it& r) { m_pointee = r.m_pointee; return *this; }
+    using pointer           = typename std::conditional<Const, const value_type*, value_type*>::type;
+    using reference         = typename std::conditional<Const, const value_type&, value_type&>::type;
+
+    radix_tree_it() : m_pointee(0), m_root(0) { }
+    radix_tree_it(const radix_tree_it& r) : m_pointee(r.m_pointee), m_root(r.m_root) { }
+    radix_tree_it& operator=(const radix_tree_it& r) { m_pointee = r.m_pointee; m_root = r.m_root; return *this; }
+    // iterator converts to const_iterator, not the other way round
+    template <bool C, typename = typename std::enable_if<Const && ! C>::type>
+    radix_tree_it(const radix_tree_it<K, T, Compare, Alloc, C>& r) : m_pointee(r.m_pointee), m_root(r.m_root) { }
     ~radix_tree_it() { }
 
-    std::pair<const K, T>& operator*  () const;
-    std::pair<const K, T>* operator-> () const;
-    const radix_tree_it<K, T, Compare>& operator++ ();
-    radix_tree_it<K, T, Compare> operator++ (int);
-    bool operator== (const radix_tree_it<K, T, Compare> &lhs) const;
+    reference operator*  () const;
+    pointer   operator-> () const;
+    radix_tree_it<K, T, Compare, Alloc, Const>& operator++ ();
+    radix_tree_it<K, T, Compare, Alloc, Const> operator++ (int);
+    radix_tree_it<K, T, Compare, Alloc, Const>& operator-- ();
+    radix_tree_it<K, T, Compare, Alloc, Const> operator-- (int);
+    template <bool C>
+    bool operator== (const radix_tree_it<K, T, Compare, Alloc, C> &lhs) const { return m_pointee == lhs.m_pointee; }
 
 private:
-    radix_tree_node<K, T, Compare> *m_pointee;
-    radix_tree_it(radix_tree_node<K, T, Compare> *p) : m_pointee(p) { }
-
-    radix_tree_node<K, T, Compare>* increment(radix_tree_node<K, T, Compare>* node) const;
-    radix_tree_node<K, T, Compare>* descend(radix_tree_node<K, T, Compare>* node) const;
+    radix_tree_node<K, T, Compare, Alloc> *m_pointee;
+    radix_tree_node<K, T, Compare, Alloc> * const *m_root; // the tree's root slot, to step back from end()
+    radix_tree_it(radix_tree_node<K, T, Compare, Alloc> *p, radix_tree_node<K, T, Compare, Alloc> * const *root) : m_pointee(p), m_root(root) { }
+
+    static radix_tree_node<K, T, Compare, Alloc>* increment(radix_tree_node<K, T, Compare, Alloc>* node);
+    static radix_tree_node<K, T, Compare, Alloc>* decrement(radix_tree_node<K, T, Compare, Alloc>* node);
+    static radix_tree_node<K, T, Compare, Alloc>* ascend(radix_tree_node<K, T, Compare, Alloc>* node);
+    static radix_tree_node<K, T, Compare, Alloc>* descend(radix_tree_node<K, T, Compare, Alloc>* node);
+    static radix_tree_node<K, T, Compare, Alloc>* rightmost(radix_tree_node<K, T, Compare, Alloc>* node);
 };
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree_it<K, T, Compare>::increment(radix_tree_node<K, T, Compare>* node) const
+// entries are visited in Compare order: a node's own value sorts among its
+// children where an empty label would, which for byte order is before all
+// of them. Every step moves along parent links and asks a children container
+// for a neighbour of a known child, so a full scan touches each edge twice.
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree_it<K, T, Compare, Alloc, Const>::increment(radix_tree_node<K, T, Compare, Alloc>* node)
+{
+    radix_tree_node<K, T, Compare, Alloc>* child = node->m_children.after_value();
+
+    RADIX_TREE_COUNT(iterator_steps, 1);
+    return (child != NULL) ? descend(child) : ascend(node);
+}
+
+// the next entry after the subtree below node
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree_it<K, T, Compare, Alloc, Const>::ascend(radix_tree_node<K, T, Compare, Alloc>* node)
 {
-    radix_tree_node<K, T, Compare>* parent = node->m_parent;
+    for (;;) {
+        radix_tree_node<K, T, Compare, Alloc>* parent = node->m_parent;
 
-    if (parent == NULL)
-        return NULL;
+        if (parent == NULL)
+            return NULL;
 
-    typename radix_tree_node<K, T, Compare>::it_child it = parent->m_children.find(node->m_key);
-    assert(it != parent->m_children.end());
-    ++it;
+        RADIX_TREE_COUNT(nodes_visited, 1);
+        radix_tree_node<K, T, Compare, Alloc>* next = parent->m_children.next(node);
 
-    return (it == parent->m_children.end()) ? increment(parent) : descend(it->second);
+        // the parent's value, if node was the last child ahead of it
+        if (parent->m_has_value && parent->m_children.before_value(node) &&
+            (next == NULL || ! parent->m_children.before_value(next)))
+            return parent;
+
+        if (next != NULL)
+            return descend(next);
+
+        node = parent;
+    }
 }
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>* radix_tree_it<K, T, Compare>::descend(radix_tree_node<K, T, Compare>* node) const
+// the first entry below node
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree_it<K, T, Compare, Alloc, Const>::descend(radix_tree_node<K, T, Compare, Alloc>* node)
 {
-    if (node->m_is_leaf)
-        return node;
+    RADIX_TREE_COUNT(nodes_visited, 1);
+    while (! (node->m_has_value && node->m_children.value_first())) {
+        node = node->m_children.first();
+        assert(node != NULL);
+        RADIX_TREE_COUNT(nodes_visited, 1);
+    }
+
+    return node;
+}
 
-    auto it = node->m_children.begin();
-    assert(it != node->m_children.end());
-    return descend(it->second);
+// the last entry below node
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree_it<K, T, Compare, Alloc, Const>::rightmost(radix_tree_node<K, T, Compare, Alloc>* node)
+{
+    for (radix_tree_node<K, T, Compare, Alloc>* child = node->m_children.last(); child != NULL; child = node->m_children.last()) {
+        if (node->m_has_value && node->m_children.before_value(child))
+            return node;
+        RADIX_TREE_COUNT(nodes_visited, 1);
+        node = child;
+    }
+
+    // only a root without children can lack a value here
+    return node->m_has_value ? node : NULL;
 }
 
-template <typename K, typename T, typename Compare>
-std::pair<const K, T>& radix_tree_it<K, T, Compare>::operator* () const
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_node<K, T, Compare, Alloc>* radix_tree_it<K, T, Compare, Alloc, Const>::decrement(radix_tree_node<K, T, Compare, Alloc>* node)
 {
-    return *m_pointee->m_value;
+    RADIX_TREE_COUNT(iterator_steps, 1);
+
+    // children ahead of node's own value
+    if (! node->m_children.value_first()) {
+        radix_tree_node<K, T, Compare, Alloc>* after = node->m_children.after_value();
+
+        return rightmost(after != NULL ? node->m_children.prev(after) : node->m_children.last());
+    }
+
+    for (;;) {
+        radix_tree_node<K, T, Compare, Alloc>* parent = node->m_parent;
+
+        if (parent == NULL)
+            return NULL;
+
+        RADIX_TREE_COUNT(nodes_visited, 1);
+        radix_tree_node<K, T, Compare, Alloc>* prev = parent->m_children.prev(node);
+
+        // the parent's value, if node was the first child behind it
+        if (parent->m_has_value && ! parent->m_children.before_value(node) &&
+            (prev == NULL || parent->m_children.before_value(prev)))
+            return parent;
+
+        if (prev != NULL)
+            return rightmost(prev);
+
+        node = parent;
+    }
 }
 
-template <typename K, typename T, typename Compare>
-std::pair<const K, T>* radix_tree_it<K, T, Compare>::operator-> () const
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+typename radix_tree_it<K, T, Compare, Alloc, Const>::reference radix_tree_it<K, T, Compare, Alloc, Const>::operator* () const
 {
-    return m_pointee->m_value;
+    return m_pointee->value();
 }
 
-template <typename K, typename T, typename Compare>
-bool radix_tree_it<K, T, Compare>::operator== (const radix_tree_it<K, T, Compare> &lhs) const
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+typename radix_tree_it<K, T, Compare, Alloc, Const>::pointer radix_tree_it<K, T, Compare, Alloc, Const>::operator-> () const
 {
-    return m_pointee == lhs.m_pointee;
+    return &m_pointee->value();
 }
 
-template <typename K, typename T, typename Compare>
-const radix_tree_it<K, T, Compare>& radix_tree_it<K, T, Compare>::operator++ ()
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_it<K, T, Compare, Alloc, Const>& radix_tree_it<K, T, Compare, Alloc, Const>::operator++ ()
 {
     if (m_pointee != NULL) // it is undefined behaviour to dereference iterator that is out of bounds...
         m_pointee = increment(m_pointee);
     return *this;
 }
 
-template <typename K, typename T, typename Compare>
-radix_tree_it<K, T, Compare> radix_tree_it<K, T, Compare>::operator++ (int)
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_it<K, T, Compare, Alloc, Const> radix_tree_it<K, T, Compare, Alloc, Const>::operator++ (int)
 {
-    radix_tree_it<K, T, Compare> copy(*this);
+    radix_tree_it<K, T, Compare, Alloc, Const> copy(*this);
     ++(*this);
     return copy;
 }
 
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_it<K, T, Compare, Alloc, Const>& radix_tree_it<K, T, Compare, Alloc, Const>::operator-- ()
+{
+    if (m_pointee != NULL)
+        m_pointee = decrement(m_pointee);
+    else if (m_root != NULL && *m_root != NULL)
+        m_pointee = rightmost(*m_root);
+    return *this;
+}
+
+template <typename K, typename T, typename Compare, typename Alloc, bool Const>
+radix_tree_it<K, T, Compare, Alloc, Const> radix_tree_it<K, T, Compare, Alloc, Const>::operator-- (int)
+{
+    radix_tree_it<K, T, Compare, Alloc, Const> copy(*this);
+    --(*this);
+    return copy;
+}
+
 #endif // RADIX_TREE_IT
@@ -0,0 +1,514 @@
+#ifndef RADIX_TREE_LPM_HPP
+#define RADIX_TREE_LPM_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "patricia_tree.hpp"
+
+/*
+ * Compiled IPv4 longest-prefix-match tables. The routes are kept in a
+ * patricia_tree as the rule set; a lookup table is generated from it and,
+ * after insert() or erase(), only the part of the table covered by the
+ * changed prefix is regenerated. Routes are fed from the control plane, e.g.
+ * a radix_tree<rtentry, ...>, with add() followed by one rebuild().
+ *
+ * Lookups go to the compiled table only and never touch the rule set.
+ */
+template <typename T>
+class radix_lpm_rules {
+public:
+    typedef std::uint32_t addr_type;
+    typedef T             mapped_type;
+    typedef std::size_t   size_type;
+
+    size_type size() const { return m_rules.size(); }
+    bool empty() const { return m_rules.empty(); }
+
+    // exact route from the rule set
+    const T* find(addr_type addr, int len) const {
+        const std::uint32_t *slot = m_rules.find(addr, len);
+        return slot == NULL ? NULL : &*m_values[*slot];
+    }
+
+protected:
+    patricia_tree<addr_type, std::uint32_t> m_rules;  // route -> index into m_values
+    std::vector<std::optional<T> >          m_values;
+    std::vector<std::uint32_t>              m_free;
+
+    radix_lpm_rules() { }
+
+    // stores the route without touching the compiled table
+    void add_rule(addr_type addr, int len, const T &value);
+    bool erase_rule(addr_type addr, int len);
+    void clear_rules();
+
+    // value index + 1 of the longest route covering addr, 0 if none
+    std::uint32_t match(addr_type addr, int maxlen = 32) const {
+        const std::uint32_t *slot = m_rules.longest_match_upto(addr, maxlen);
+        return slot == NULL ? 0 : *slot + 1;
+    }
+
+    const T* value(std::uint32_t entry) const { return entry == 0 ? NULL : &*m_values[entry - 1]; }
+
+private:
+    radix_lpm_rules(const radix_lpm_rules&); // delete
+    radix_lpm_rules& operator=(const radix_lpm_rules&); // delete
+};
+
+template <typename T>
+void radix_lpm_rules<T>::add_rule(addr_type addr, int len, const T &value)
+{
+    if (const std::uint32_t *slot = m_rules.find(addr, len)) {
+        m_values[*slot] = value;
+        return;
+    }
+
+    std::uint32_t slot;
+    if (m_free.empty()) {
+        slot = static_cast<std::uint32_t>(m_values.size());
+        m_values.push_back(value);
+    } else {
+        slot = m_free.back();
+        m_free.pop_back();
+        m_values[slot] = value;
+    }
+
+    m_rules.insert(addr, len, slot);
+}
+
+template <typename T>
+bool radix_lpm_rules<T>::erase_rule(addr_type addr, int len)
+{
+    const std::uint32_t *slot = m_rules.find(addr, len);
+    if (slot == NULL)
+        return false;
+
+    m_values[*slot].reset();
+    m_free.push_back(*slot);
+    m_rules.erase(addr, len);
+
+    return true;
+}
+
+template <typename T>
+void radix_lpm_rules<T>::clear_rules()
+{
+    m_rules.clear();
+    m_values.clear();
+    m_free.clear();
+}
+
+/*
+ * DIR-24-8: one 2^24 entry table indexed by the top 24 address bits, and a
+ * 256 entry group for each /24 that holds longer routes. A lookup is one
+ * memory access, two for addresses under a route longer than /24. Costs 64MB
+ * for the first table.
+ *
+ * As in DPDK, every entry keeps the length of its route next to the value
+ * index. An insert overwrites only the entries under the new prefix whose
+ * route is not longer; an erase hands those of the erased route to the
+ * route covering it, which is looked up once. Neither walks the rule set per
+ * entry. Value indices take 25 bits, which limits a table to 2^25 - 1 routes.
+ */
+template <typename T>
+class dir24_8_lpm : public radix_lpm_rules<T> {
+public:
+    typedef std::uint32_t addr_type;
+
+    dir24_8_lpm() : m_tbl24(std::size_t(1) << 24, 0) { }
+
+    void add(addr_type addr, int len, const T &value) { this->add_rule(addr, len, value); }
+    void rebuild();
+    void clear();
+
+    void insert(addr_type addr, int len, const T &value);
+    bool erase(addr_type addr, int len);
+
+    const T* longest_match(addr_type addr) const {
+        std::uint32_t entry = m_tbl24[addr >> 8];
+        if (entry & group_flag)
+            entry = m_tbl8[((entry & ~group_flag) << 8) | (addr & 0xff)];
+        return this->value(entry & value_mask);
+    }
+
+private:
+    // an entry is the group index with group_flag set, or the route's length
+    // above its value index + 1 (0 if no route covers it)
+    static constexpr std::uint32_t group_flag = 0x80000000u;
+    static constexpr int           len_shift  = 25;
+    static constexpr std::uint32_t value_mask = (std::uint32_t(1) << len_shift) - 1;
+
+    std::vector<std::uint32_t> m_tbl24;
+    std::vector<std::uint32_t> m_tbl8;
+    std::vector<std::uint32_t> m_free_groups;
+
+    static std::uint32_t make_entry(int len, std::uint32_t value)
+    {
+        assert(value <= value_mask);
+        return (std::uint32_t(len) << len_shift) | value;
+    }
+    static int entry_len(std::uint32_t entry) { return static_cast<int>(entry >> len_shift); }
+
+    void write(addr_type addr, int len, std::uint32_t entry);
+    static void write_range(std::uint32_t *first, std::uint32_t *last, int len, std::uint32_t entry);
+    std::uint32_t new_group();
+};
+
+template <typename T>
+void dir24_8_lpm<T>::clear()
+{
+    this->clear_rules();
+    std::fill(m_tbl24.begin(), m_tbl24.end(), 0);
+    m_tbl8.clear();
+    m_free_groups.clear();
+}
+
+template <typename T>
+void dir24_8_lpm<T>::rebuild()
+{
+    std::fill(m_tbl24.begin(), m_tbl24.end(), 0);
+    m_tbl8.clear();
+    m_free_groups.clear();
+
+    struct route {
+        addr_type     addr;
+        int           len;
+        std::uint32_t entry;
+    };
+    std::vector<route> routes;
+
+    this->m_rules.for_each([&](addr_type addr, int len, std::uint32_t slot) {
+        routes.push_back(route{ addr, len, make_entry(len, slot + 1) });
+    });
+
+    // shorter routes first, so that longer ones overwrite them
+    std::stable_sort(routes.begin(), routes.end(), [](const route &a, const route &b) { return a.len < b.len; });
+    for (std::size_t i = 0; i < routes.size(); i++)
+        write(routes[i].addr, routes[i].len, routes[i].entry);
+}
+
+template <typename T>
+void dir24_8_lpm<T>::insert(addr_type addr, int len, const T &value)
+{
+    this->add_rule(addr, len, value);
+    write(addr, len, make_entry(len, *this->m_rules.find(addr, len) + 1));
+}
+
+template <typename T>
+bool dir24_8_lpm<T>::erase(addr_type addr, int len)
+{
+    if (! this->erase_rule(addr, len))
+        return false;
+
+    int cover_len = 0;
+    const std::uint32_t *cover = len == 0 ? NULL : this->m_rules.longest_match_upto(addr, len - 1, &cover_len);
+
+    write(addr, len, cover == NULL ? 0 : make_entry(cover_len, *cover + 1));
+    return true;
+}
+
+// entry replaces the entries in [first, last) of routes not longer than len
+template <typename T>
+void dir24_8_lpm<T>::write_range(std::uint32_t *first, std::uint32_t *last, int len, std::uint32_t entry)
+{
+    for (; first != last; ++first) {
+        if (entry_len(*first) <= len)
+            *first = entry;
+    }
+}
+
+// entry takes over the addresses under addr/len that are not covered by a
+// longer route
+template <typename T>
+void dir24_8_lpm<T>::write(addr_type addr, int len, std::uint32_t entry)
+{
+    addr &= radix_bits<addr_type>::mask(len);
+
+    if (len <= 24) {
+        std::uint32_t first = addr >> 8;
+        std::uint32_t last  = first + (std::uint32_t(1) << (24 - len));
+
+        for (std::uint32_t block = first; block != last; block++) {
+            std::uint32_t e = m_tbl24[block];
+
+            if (e & group_flag) {
+                std::uint32_t *group = &m_tbl8[(e & ~group_flag) << 8];
+                write_range(group, group + 256, len, entry);
+            } else if (entry_len(e) <= len) {
+                m_tbl24[block] = entry;
+            }
+        }
+        return;
+    }
+
+    std::uint32_t block = addr >> 8;
+    std::uint32_t e     = m_tbl24[block];
+
+    // the /24 gets a group, starting out with the route that covered it
+    if ((e & group_flag) == 0) {
+        std::uint32_t group = new_group();
+        std::fill_n(m_tbl8.begin() + (group << 8), 256, e);
+        e = group | group_flag;
+        m_tbl24[block] = e;
+    }
+
+    std::uint32_t *group = &m_tbl8[(e & ~group_flag) << 8];
+    std::uint32_t *first = group + (addr & 0xff);
+    write_range(first, first + (std::uint32_t(1) << (32 - len)), len, entry);
+
+    // without routes longer than /24 left, the group holds one entry
+    if (entry_len(entry) <= 24 && std::all_of(group, group + 256, [](std::uint32_t x) { return entry_len(x) <= 24; })) {
+        m_tbl24[block] = group[0];
+        m_free_groups.push_back(e & ~group_flag);
+    }
+}
+
+template <typename T>
+std::uint32_t dir24_8_lpm<T>::new_group()
+{
+    if (! m_free_groups.empty()) {
+        std::uint32_t group = m_free_groups.back();
+        m_free_groups.pop_back();
+        return group;
+    }
+
+    std::uint32_t group = static_cast<std::uint32_t>(m_tbl8.size() >> 8);
+    m_tbl8.resize(m_tbl8.size() + 256);
+    return group;
+}
+
+/*
+ * Poptrie: a direct-pointing table over the top 16 bits, below it a multibit
+ * trie of 6-bit strides. Each trie node has two 64-bit bitmaps, one marking
+ * the children that are nodes and one marking where a run of equal leaves
+ * starts; children and leaves are stored contiguously, so a child is found
+ * at base + popcount of the bitmap below its bit. Runs of equal leaves are
+ * stored once, which keeps the table small enough to stay in cache.
+ *
+ * insert() and erase() regenerate the subtrees under the changed prefix at
+ * the end of the arrays; the arrays are compacted by a full rebuild once the
+ * abandoned part outgrows the live one.
+ */
+template <typename T>
+class poptrie_lpm : public radix_lpm_rules<T> {
+public:
+    typedef std::uint32_t addr_type;
+
+    poptrie_lpm() : m_direct(direct_size, leaf_flag), m_sizes(direct_size), m_live_nodes(0), m_live_leaves(0) { }
+
+    void add(addr_type addr, int len, const T &value) { this->add_rule(addr, len, value); }
+    void rebuild();
+    void clear();
+
+    void insert(addr_type addr, int len, const T &value);
+    bool erase(addr_type addr, int len);
+
+    const T* longest_match(addr_type addr) const;
+
+    // trie nodes and leaves in use, for sizing
+    std::size_t node_count() const { return m_live_nodes; }
+    std::size_t leaf_count() const { return m_live_leaves; }
+
+private:
+    enum { direct_bits = 16, stride = 6, direct_size = 1 << direct_bits };
+
+    static constexpr std::uint32_t leaf_flag = 0x80000000u;
+
+    struct node {
+        std::uint64_t m_vector;   // children that are nodes
+        std::uint64_t m_leafvec;  // children that start a run of leaves
+        std::uint32_t m_base0;    // first leaf
+        std::uint32_t m_base1;    // first child node
+    };
+
+    // addresses are left-aligned in 64 bits, so strides past bit 32 read zeros
+    struct route {
+        std::uint64_t addr;
+        int           len;
+        std::uint32_t entry;
+    };
+
+    struct subtree_size {
+        std::uint32_t nodes;
+        std::uint32_t leaves;
+    };
+
+    std::vector<std::uint32_t> m_direct;  // leaf_flag | entry, or a node index
+    std::vector<node>          m_nodes;
+    std::vector<std::uint32_t> m_leaves;
+    std::vector<subtree_size>  m_sizes;   // per direct entry
+    std::size_t                m_live_nodes;
+    std::size_t                m_live_leaves;
+
+    void update(addr_type addr, int len);
+    void rebuild_direct(std::uint32_t index);
+    void build(std::uint32_t index, int depth, const std::vector<route> &routes, std::uint32_t entry);
+};
+
+template <typename T>
+const T* poptrie_lpm<T>::longest_match(addr_type addr) const
+{
+    std::uint32_t index = m_direct[addr >> (32 - direct_bits)];
+    if (index & leaf_flag)
+        return this->value(index & ~leaf_flag);
+
+    std::uint64_t key   = std::uint64_t(addr) << 32;
+    int           depth = direct_bits;
+
+    for (;;) {
+        const node   &n    = m_nodes[index];
+        std::uint64_t bit  = std::uint64_t(1) << ((key << depth) >> (64 - stride));
+        std::uint64_t upto = bit | (bit - 1);
+
+        if ((n.m_vector & bit) == 0)
+            return this->value(m_leaves[n.m_base0 + std::popcount(n.m_leafvec & upto) - 1]);
+
+        index  = n.m_base1 + std::popcount(n.m_vector & upto) - 1;
+        depth += stride;
+    }
+}
+
+template <typename T>
+void poptrie_lpm<T>::clear()
+{
+    this->clear_rules();
+    rebuild();
+}
+
+template <typename T>
+void poptrie_lpm<T>::rebuild()
+{
+    m_nodes.clear();
+    m_leaves.clear();
+    m_live_nodes  = 0;
+    m_live_leaves = 0;
+    std::fill(m_sizes.begin(), m_sizes.end(), subtree_size{ 0, 0 });
+
+    for (std::uint32_t index = 0; index < direct_size; index++)
+        rebuild_direct(index);
+}
+
+template <typename T>
+void poptrie_lpm<T>::insert(addr_type addr, int len, const T &value)
+{
+    this->add_rule(addr, len, value);
+    update(addr, len);
+}
+
+template <typename T>
+bool poptrie_lpm<T>::erase(addr_type addr, int len)
+{
+    if (! this->erase_rule(addr, len))
+        return false;
+
+    update(addr, len);
+    return true;
+}
+
+template <typename T>
+void poptrie_lpm<T>::update(addr_type addr, int len)
+{
+    addr &= radix_bits<addr_type>::mask(len);
+
+    std::uint32_t first = addr >> (32 - direct_bits);
+    std::uint32_t last  = first + (len < direct_bits ? std::uint32_t(1) << (direct_bits - len) : 1);
+
+    for (std::uint32_t index = first; index != last; index++)
+        rebuild_direct(index);
+
+    if (m_nodes.size() - m_live_nodes > m_live_nodes + 1024 || m_leaves.size() - m_live_leaves > m_live_leaves + 1024)
+        rebuild();
+}
+
+template <typename T>
+void poptrie_lpm<T>::rebuild_direct(std::uint32_t index)
+{
+    addr_type          base = index << (32 - direct_bits);
+    std::vector<route> routes;
+
+    this->m_rules.for_each_within(base, direct_bits, [&](addr_type addr, int len, std::uint32_t slot) {
+        if (len > direct_bits)
+            routes.push_back(route{ std::uint64_t(addr) << 32, len, slot + 1 });
+    });
+
+    m_live_nodes  -= m_sizes[index].nodes;
+    m_live_leaves -= m_sizes[index].leaves;
+
+    std::uint32_t entry = this->match(base, direct_bits);
+
+    if (routes.empty()) {
+        m_direct[index] = entry | leaf_flag;
+        m_sizes[index]  = subtree_size{ 0, 0 };
+        return;
+    }
+
+    // the children of a node are painted in order, shorter routes first
+    std::stable_sort(routes.begin(), routes.end(), [](const route &a, const route &b) { return a.len < b.len; });
+
+    std::size_t nodes  = m_nodes.size();
+    std::size_t leaves = m_leaves.size();
+
+    m_nodes.push_back(node());
+    build(static_cast<std::uint32_t>(nodes), direct_bits, routes, entry);
+
+    m_direct[index] = static_cast<std::uint32_t>(nodes);
+    m_sizes[index]  = subtree_size{ static_cast<std::uint32_t>(m_nodes.size() - nodes), static_cast<std::uint32_t>(m_leaves.size() - leaves) };
+    m_live_nodes   += m_sizes[index].nodes;
+    m_live_leaves  += m_sizes[index].leaves;
+}
+
+template <typename T>
+void poptrie_lpm<T>::build(std::uint32_t index, int depth, const std::vector<route> &routes, std::uint32_t entry)
+{
+    std::uint32_t      leaf[64];
+    std::vector<route> below[64];
+    std::uint64_t      vector = 0;
+
+    std::fill_n(leaf, 64, entry);
+
+    for (std::size_t i = 0; i < routes.size(); i++) {
+        const route  &r     = routes[i];
+        std::uint32_t child = static_cast<std::uint32_t>((r.addr << depth) >> (64 - stride));
+
+        if (r.len > depth + stride) {
+            vector |= std::uint64_t(1) << child;
+            below[child].push_back(r);
+        } else {
+            std::fill_n(leaf + child, std::size_t(1) << (depth + stride - r.len), r.entry);
+        }
+    }
+
+    std::uint64_t leafvec = 0;
+    std::uint32_t base0   = static_cast<std::uint32_t>(m_leaves.size());
+
+    for (int child = 0; child < 64; child++) {
+        if (vector & (std::uint64_t(1) << child))
+            continue;
+        if (child == 0 || (vector & (std::uint64_t(1) << (child - 1))) || leaf[child] != leaf[child - 1]) {
+            leafvec |= std::uint64_t(1) << child;
+            m_leaves.push_back(leaf[child]);
+        }
+    }
+
+    std::uint32_t base1 = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.resize(m_nodes.size() + std::popcount(vector));
+
+    node &n = m_nodes[index];
+    n.m_vector  = vector;
+    n.m_leafvec = leafvec;
+    n.m_base0   = base0;
+    n.m_base1   = base1;
+
+    std::uint32_t next = base1;
+    for (int child = 0; child < 64; child++)
+        if (vector & (std::uint64_t(1) << child))
+            build(next++, depth + stride, below[child], leaf[child]);
+}
+
+#endif // RADIX_TREE_LPM_HPP
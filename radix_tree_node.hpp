@@ -1,55 +1,144 @@
 #ifndef RADIX_TREE_NODE_HPP
 #define RADIX_TREE_NODE_HPP
 
-#include <map>
+#include <cassert>
+#include <cstdint>
 #include <functional>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
 
-template <typename K, typename T, typename Compare>
+#include "radix_tree_children.hpp"
+
+template <typename K, typename T, typename Compare, typename Alloc> class radix_tree_value_node;
+
+// selects the radix_tree_value_node constructor that leaves the value out
+struct radix_tree_empty_storage { };
+
+// std::string keys in the adaptive layout get compact labels, see below
+template <typename K, typename Compare>
+struct radix_tree_compact_labels : std::integral_constant<bool,
+    std::is_same<K, std::string>::value && radix_tree_adaptive_nodes<K, Compare>::value> { };
+
+/*
+ * Edge label of a byte key stored in 8 bytes: its length and its first
+ * bytes. A label that fits is kept whole; of a longer one only the head is
+ * kept, and the rest is read from the key of any value node below, which
+ * spells the same bytes at the same depth. Short labels thus never leave the
+ * node and long ones are not stored twice.
+ */
+struct radix_tree_compact_label {
+    enum { inline_size = 4 };
+
+    radix_tree_compact_label() : m_len(0) { }
+
+    std::uint32_t m_len;
+    char          m_head[inline_size];
+};
+
+/*
+ * A node is labelled with the key piece on the edge from its parent. A node
+ * whose path from the root spells a stored key holds that key's value; such
+ * nodes are allocated as radix_tree_value_node, which carries the value in
+ * the same allocation. Nodes created only to split an edge carry no value
+ * storage at all.
+ *
+ * With compact labels a plain node of a std::string tree is 32 bytes: child
+ * table pointer, parent, depth and label.
+ */
+template <typename K, typename T, typename Compare, typename Alloc>
 class radix_tree_node {
-    friend class radix_tree<K, T, Compare>;
-    friend class radix_tree_it<K, T, Compare>;
+    friend class radix_tree<K, T, Compare, Alloc>;
+    template <typename, typename, typename, typename, bool> friend class radix_tree_it;
+    friend class radix_tree_value_node<K, T, Compare, Alloc>;
+    template <typename, typename, typename, typename, bool> friend class radix_tree_children;
+    template <typename> friend class radix_tree_image;
 
     typedef std::pair<const K, T> value_type;
-    typedef typename std::map<K, radix_tree_node<K, T, Compare>*, Compare >::iterator it_child;
+    typedef radix_tree_children<K, radix_tree_node<K, T, Compare, Alloc>, Compare, Alloc> children_type;
 
 private:
-	radix_tree_node(Compare& pred) : m_children(std::map<K, radix_tree_node<K, T, Compare>*, Compare>(pred)), m_parent(NULL), m_value(NULL), m_depth(0), m_is_leaf(false), m_key(), m_pred(pred) { }
-    radix_tree_node(const value_type &val, Compare& pred);
+    static const bool compact_label = radix_tree_compact_labels<K, Compare>::value;
+    typedef typename std::conditional<compact_label, radix_tree_compact_label, K>::type label_type;
+
+	radix_tree_node(Compare& pred, const Alloc& alloc) : m_children(pred, alloc), m_position(), m_parent(NULL), m_depth(0), m_key(), m_has_value(false), m_has_storage(false) { }
     radix_tree_node(const radix_tree_node&); // delete
     radix_tree_node& operator=(const radix_tree_node&); // delete
 
-    ~radix_tree_node();
+    // children are freed by the owning radix_tree, which holds the allocator
+    ~radix_tree_node() { }
+
+    value_type& value();
+
+    // first element of the label, which the parent indexes the node by
+    decltype(auto) label_front() const {
+        if constexpr (compact_label)
+            return m_key.m_head[0];
+        else
+            return m_key[0];
+    }
 
-    std::map<K, radix_tree_node<K, T, Compare>*, Compare> m_children;
-    radix_tree_node<K, T, Compare> *m_parent;
-    value_type *m_value;
+    children_type m_children;
+    [[no_unique_address]] typename children_type::position m_position; // among the parent's children
+    radix_tree_node<K, T, Compare, Alloc> *m_parent;
     int m_depth;
-    bool m_is_leaf;
-    K m_key;
-	Compare& m_pred;
+    label_type m_key;
+    bool m_has_value;   // the path to this node is a stored key
+    bool m_has_storage; // allocated as radix_tree_value_node
 };
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>::radix_tree_node(const value_type &val, Compare& pred) :
-    m_children(std::map<K, radix_tree_node<K, T, Compare>*, Compare>(pred)),
-    m_parent(NULL),
-    m_value(NULL),
-    m_depth(0),
-    m_is_leaf(false),
-    m_key(), 
-	m_pred(pred)
-{
-    m_value = new value_type(val);
-}
+template <typename K, typename T, typename Compare, typename Alloc>
+class radix_tree_value_node : public radix_tree_node<K, T, Compare, Alloc> {
+    friend class radix_tree<K, T, Compare, Alloc>;
+    friend class radix_tree_node<K, T, Compare, Alloc>;
 
-template <typename K, typename T, typename Compare>
-radix_tree_node<K, T, Compare>::~radix_tree_node()
-{
-    it_child it;
-    for (it = m_children.begin(); it != m_children.end(); ++it) {
-        delete it->second;
+    typedef std::pair<const K, T> value_type;
+
+private:
+    template <typename... Args>
+    radix_tree_value_node(Compare& pred, const Alloc& alloc, Args&&... args) : radix_tree_node<K, T, Compare, Alloc>(pred, alloc), m_value(std::forward<Args>(args)...)
+    {
+        this->m_has_value   = true;
+        this->m_has_storage = true;
+    }
+
+    radix_tree_value_node(Compare& pred, const Alloc& alloc, radix_tree_empty_storage) : radix_tree_node<K, T, Compare, Alloc>(pred, alloc)
+    {
+        this->m_has_storage = true;
+    }
+
+    ~radix_tree_value_node()
+    {
+        if (this->m_has_value)
+            m_value.~value_type();
     }
-    delete m_value;
+
+    template <typename... Args>
+    void emplace(Args&&... args)
+    {
+        ::new (static_cast<void*>(&m_value)) value_type(std::forward<Args>(args)...);
+        this->m_has_value = true;
+    }
+
+    void reset()
+    {
+        m_value.~value_type();
+        this->m_has_value = false;
+    }
+
+    // a union keeps the value's lifetime separate from the node's: after an
+    // erase the node may stay in the tree as a plain branching node
+    union {
+        value_type m_value;
+    };
+};
+
+template <typename K, typename T, typename Compare, typename Alloc>
+typename radix_tree_node<K, T, Compare, Alloc>::value_type& radix_tree_node<K, T, Compare, Alloc>::value()
+{
+    assert(m_has_value);
+    return static_cast<radix_tree_value_node<K, T, Compare, Alloc>*>(this)->m_value;
 }
 
 
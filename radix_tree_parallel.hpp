@@ -0,0 +1,55 @@
+#ifndef RADIX_TREE_PARALLEL_HPP
+#define RADIX_TREE_PARALLEL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs f(0) .. f(tasks - 1) on up to threads threads, the calling one
+ * included. Threads take the next task index from a shared counter, so
+ * uneven tasks balance out as long as there are several per thread.
+ *
+ * If some threads cannot be started the others do their share. The first
+ * exception thrown by a task is rethrown once all threads have stopped;
+ * tasks not started by then are skipped.
+ */
+template <typename F>
+void radix_tree_run_parallel(unsigned threads, std::size_t tasks, F f)
+{
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool>        failed(false);
+    std::exception_ptr       error;
+
+    auto work = [&]() {
+        for (std::size_t i = next++; i < tasks && ! failed.load(std::memory_order_relaxed); i = next++) {
+            try {
+                f(i);
+            } catch (...) {
+                if (! failed.exchange(true))
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < threads && i < tasks; i++) {
+        try {
+            workers.emplace_back(work);
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+
+    work();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+#endif // RADIX_TREE_PARALLEL_HPP
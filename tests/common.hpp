@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <map>
+#include <memory>
+#include <new>
 
 // this file contains some common code for all tests to reduce the number of copypaste lines
 
@@ -10,6 +12,38 @@ typedef radix_tree<std::string, int> tree_t;
 typedef std::vector<tree_t::iterator> vector_found_t;
 typedef std::map<std::string, int> map_found_t;
 
+// orders keys backwards, to cover the reversed code paths
+struct greater_string {
+    bool operator() (const std::string &a, const std::string &b) const { return a > b; }
+};
+
+// fails the allocation after a given number of them
+static long allocations_left = -1;
+
+template <typename T>
+struct failing_allocator {
+    typedef T value_type;
+
+    failing_allocator() { }
+    template <typename U>
+    failing_allocator(const failing_allocator<U>&) { }
+
+    T* allocate(std::size_t n)
+    {
+        if (allocations_left == 0)
+            throw std::bad_alloc();
+        if (allocations_left > 0)
+            allocations_left--;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+    template <typename U>
+    bool operator== (const failing_allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!= (const failing_allocator<U>&) const { return false; }
+};
+
 template<typename _RAIter>
 bool is_unique(_RAIter begin, _RAIter end) {
     std::sort(begin, end);
@@ -0,0 +1,233 @@
+#include "common.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <concurrent_radix_tree.hpp>
+
+typedef concurrent_radix_tree<std::string, int> ctree_t;
+
+TEST(concurrent, matches_map)
+{
+    ctree_t tree;
+    std::map<std::string, int> map;
+
+    for (int i = 0; i < 20000; i++) {
+        std::string key;
+        int len = rand() % 5;
+        for (int j = 0; j < len; j++)
+            key += static_cast<char>('a' + rand() % 4);
+
+        switch (rand() % 4) {
+        case 0:
+            ASSERT_EQ(map.insert(std::make_pair(key, i)).second, tree.insert(ctree_t::value_type(key, i)));
+            break;
+        case 1:
+            ASSERT_EQ(map.erase(key) == 1, tree.erase(key));
+            break;
+        case 2:
+            ASSERT_EQ(map.find(key) == map.end(), tree.insert_or_assign(key, i));
+            map[key] = i;
+            break;
+        default: {
+            std::optional<int> value = tree.find(key);
+            ASSERT_EQ(map.count(key) == 1, value.has_value());
+            if (value) {
+                ASSERT_EQ(map[key], *value);
+            }
+            break;
+        }
+        }
+        ASSERT_EQ(map.size(), tree.size());
+    }
+
+    for (std::map<std::string, int>::iterator it = map.begin(); it != map.end(); ++it)
+        ASSERT_EQ(it->second, *tree.find(it->first));
+
+    // single-threaded writes leave nothing for later reclamation
+    ASSERT_EQ(0u, tree.pending_reclaim());
+}
+
+TEST(concurrent, longest_and_prefix_match)
+{
+    ctree_t tree;
+    const std::string keys[] = { "", "a", "ab", "abcd", "abce", "b" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        tree.insert(ctree_t::value_type(keys[i], static_cast<int>(i)));
+
+    ASSERT_EQ("abcd", tree.longest_match("abcdz")->first);
+    ASSERT_EQ("ab", tree.longest_match("abc")->first);
+    ASSERT_EQ("", tree.longest_match("zz")->first);
+
+    std::vector<ctree_t::value_type> vec;
+    tree.prefix_match("abc", vec);
+    ASSERT_EQ(2u, vec.size());
+    tree.prefix_match("a", vec);
+    ASSERT_EQ(4u, vec.size());
+    tree.prefix_match("abx", vec);
+    ASSERT_TRUE(vec.empty());
+
+    ASSERT_TRUE(tree.erase(""));
+    ASSERT_FALSE(tree.longest_match("zz").has_value());
+}
+
+TEST(concurrent, readers_during_writes)
+{
+    ctree_t tree;
+    for (int i = 0; i < 1000; i += 2)
+        tree.insert(ctree_t::value_type(std::to_string(i), i));
+
+    std::atomic<bool> stop(false);
+    std::atomic<int>  errors(0);
+    std::vector<std::thread> readers;
+
+    for (int t = 0; t < 4; t++) {
+        readers.push_back(std::thread([&]() {
+            while (! stop.load()) {
+                for (int i = 0; i < 1000; i++) {
+                    std::optional<int> value = tree.find(std::to_string(i));
+                    // even keys are never erased, every value equals its key
+                    if ((i % 2 == 0 && ! value) || (value && *value != i))
+                        errors++;
+                }
+            }
+        }));
+    }
+    // and one that watches the retired list the writer is filling
+    std::atomic<size_t> seen(0);
+    readers.push_back(std::thread([&]() {
+        while (! stop.load())
+            seen = std::max<size_t>(seen, tree.pending_reclaim());
+    }));
+
+    for (int round = 0; round < 20; round++) {
+        for (int i = 1; i < 1000; i += 2)
+            tree.insert(ctree_t::value_type(std::to_string(i), i));
+        for (int i = 1; i < 1000; i += 2)
+            tree.erase(std::to_string(i));
+    }
+    stop = true;
+    for (size_t t = 0; t < readers.size(); t++)
+        readers[t].join();
+
+    ASSERT_EQ(0, errors.load());
+    ASSERT_EQ(500u, tree.size());
+}
+
+TEST(concurrent, snapshot_is_frozen)
+{
+    ctree_t tree;
+    ctree_t::view empty = tree.snapshot();
+    ASSERT_TRUE(empty.empty());
+    ASSERT_FALSE(empty.find("a").has_value());
+
+    std::map<std::string, int> expected;
+    for (int i = 0; i < 1000; i++) {
+        tree.insert(ctree_t::value_type("k" + std::to_string(i), i));
+        expected["k" + std::to_string(i)] = i;
+    }
+
+    ctree_t::view snap = tree.snapshot();
+
+    for (int i = 0; i < 1000; i += 3)
+        tree.erase("k" + std::to_string(i));
+    for (int i = 1; i < 1000; i += 3)
+        tree.insert_or_assign("k" + std::to_string(i), -i);
+    tree.insert(ctree_t::value_type("k", -1));
+    tree.insert(ctree_t::value_type("k10x", -1));
+
+    ASSERT_EQ(1000u, snap.size());
+    for (std::map<std::string, int>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+        ASSERT_EQ(it->second, snap.find(it->first));
+    ASSERT_FALSE(snap.find("k").has_value());
+    ASSERT_EQ("k10", snap.longest_match("k10x")->first);
+
+    std::vector<ctree_t::value_type> vec;
+    snap.prefix_match("k99", vec);
+    ASSERT_EQ(11u, vec.size());
+
+    // the tree moved on meanwhile
+    ASSERT_FALSE(tree.find("k0").has_value());
+    ASSERT_EQ(-1, tree.find("k1"));
+    ASSERT_EQ(-1, tree.find("k10x"));
+    ASSERT_TRUE(empty.empty());
+}
+
+TEST(concurrent, snapshots_outlive_writes)
+{
+    ctree_t tree;
+    std::vector<ctree_t::view> snaps;
+
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 100; i++)
+            tree.insert_or_assign(std::to_string(i), round);
+        snaps.push_back(tree.snapshot());
+        for (int i = 0; i < 100; i += 2)
+            tree.erase(std::to_string(i));
+    }
+
+    int round = 0;
+    for (std::vector<ctree_t::view>::const_iterator snap = snaps.begin(); snap != snaps.end(); ++snap, round++) {
+        ASSERT_EQ(100u, snap->size());
+        for (int i = 0; i < 100; i++)
+            ASSERT_EQ(round, snap->find(std::to_string(i)));
+    }
+
+    // release them out of order while writing on
+    for (std::vector<ctree_t::view>::iterator snap = snaps.begin(); snap != snaps.end(); ) {
+        snap = snaps.erase(snap);
+        if (snap != snaps.end())
+            ++snap;
+        tree.insert(ctree_t::value_type("x", 1));
+    }
+    ASSERT_EQ(5u, snaps.size());
+    ASSERT_EQ(1, snaps[0].find("1"));
+
+    // assigning over a view drops the snapshot it held
+    snaps[0] = tree.snapshot();
+    ASSERT_EQ(51u, snaps[0].size());
+    ASSERT_EQ(9, snaps[0].find("1"));
+    snaps[1] = std::move(snaps[0]);
+    ASSERT_EQ(51u, snaps[1].size());
+    snaps.clear();
+
+    ASSERT_EQ(51u, tree.size());
+    ASSERT_EQ(9, tree.find("1"));
+}
+
+TEST(concurrent, snapshot_during_writes)
+{
+    ctree_t tree;
+    for (int i = 0; i < 1000; i += 2)
+        tree.insert(ctree_t::value_type(std::to_string(i), i));
+
+    std::atomic<bool> stop(false);
+    std::atomic<int>  errors(0);
+    std::thread reader([&]() {
+        while (! stop.load()) {
+            ctree_t::view snap = tree.snapshot();
+            int found = 0;
+            for (int i = 0; i < 1000; i++) {
+                std::optional<int> value = snap.find(std::to_string(i));
+                if ((i % 2 == 0 && ! value) || (value && *value != i))
+                    errors++;
+                found += value.has_value();
+            }
+            // a snapshot is consistent with its own size
+            if (static_cast<size_t>(found) != snap.size())
+                errors++;
+        }
+    });
+
+    for (int round = 0; round < 20; round++) {
+        for (int i = 1; i < 1000; i += 2)
+            tree.insert(ctree_t::value_type(std::to_string(i), i));
+        for (int i = 1; i < 1000; i += 2)
+            tree.erase(std::to_string(i));
+    }
+    stop = true;
+    reader.join();
+
+    ASSERT_EQ(0, errors.load());
+}
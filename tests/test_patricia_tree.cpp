@@ -0,0 +1,201 @@
+#include "common.hpp"
+
+#include <patricia_tree.hpp>
+
+#include <cstdlib>
+#include <new>
+
+static long g_live_allocations = 0;
+static long g_allocations_left = -1; // fails the allocation after this many, -1 never
+
+void* operator new(std::size_t size)
+{
+    if (g_allocations_left == 0)
+        throw std::bad_alloc();
+    if (g_allocations_left > 0)
+        g_allocations_left--;
+    if (void *p = std::malloc(size ? size : 1)) {
+        g_live_allocations++;
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { if (p) { g_live_allocations--; std::free(p); } }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+
+template <typename Word>
+static Word random_word()
+{
+    Word word = 0;
+    for (size_t i = 0; i < sizeof(Word); i++)
+        word = (word << 8) | static_cast<Word>(rand() & 0xff);
+    return word;
+}
+
+// longest_match against a scan of all stored prefixes
+template <typename Word>
+static void check_against_scan(int prefixes, int lookups)
+{
+    typedef radix_bits<Word> bits;
+    patricia_tree<Word, int> tree;
+    std::map<std::pair<Word, int>, int> stored;
+
+    for (int i = 0; i < prefixes; i++) {
+        // short prefixes under a few common roots, so that they nest
+        int  len  = rand() % (bits::width + 1);
+        Word addr = random_word<Word>() & bits::mask(len);
+        if (rand() % 2)
+            addr = (addr & ~bits::mask(4)) | (Word(rand() % 3) << (bits::width - 4));
+        addr &= bits::mask(len);
+
+        bool inserted = stored.insert(std::make_pair(std::make_pair(addr, len), i)).second;
+        std::pair<int*, bool> r = tree.insert(addr, len, i);
+        ASSERT_EQ(inserted, r.second);
+        ASSERT_EQ(stored[std::make_pair(addr, len)], *r.first);
+    }
+    ASSERT_EQ(stored.size(), tree.size());
+
+    for (int i = 0; i < lookups; i++) {
+        Word addr = random_word<Word>();
+        if (rand() % 2)
+            addr = (addr & ~bits::mask(4)) | (Word(rand() % 3) << (bits::width - 4));
+        if (i < static_cast<int>(stored.size()))
+            addr = std::next(stored.begin(), i)->first.first | (addr & ~bits::mask(std::next(stored.begin(), i)->first.second));
+
+        int best_len = -1, best_value = 0;
+        for (typename std::map<std::pair<Word, int>, int>::iterator it = stored.begin(); it != stored.end(); ++it) {
+            if (((addr ^ it->first.first) & bits::mask(it->first.second)) == 0 && it->first.second > best_len) {
+                best_len   = it->first.second;
+                best_value = it->second;
+            }
+        }
+
+        int len = -1;
+        const int *value = tree.longest_match(addr, &len);
+        ASSERT_EQ(best_len >= 0, value != NULL);
+        if (value != NULL) {
+            ASSERT_EQ(best_len, len);
+            ASSERT_EQ(best_value, *value);
+        }
+    }
+
+    // erase half, then every exact lookup has to agree
+    int n = 0;
+    for (typename std::map<std::pair<Word, int>, int>::iterator it = stored.begin(); it != stored.end(); n++) {
+        if (n % 2 == 0) {
+            ASSERT_TRUE(tree.erase(it->first.first, it->first.second));
+            ASSERT_FALSE(tree.erase(it->first.first, it->first.second));
+            it = stored.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ASSERT_EQ(stored.size(), tree.size());
+    for (typename std::map<std::pair<Word, int>, int>::iterator it = stored.begin(); it != stored.end(); ++it)
+        ASSERT_EQ(it->second, *tree.find(it->first.first, it->first.second));
+
+    size_t visited = 0;
+    tree.for_each([&](Word, int, const int &) { visited++; });
+    ASSERT_EQ(stored.size(), visited);
+}
+
+TEST(patricia, ipv4_against_scan)
+{
+    check_against_scan<std::uint32_t>(2000, 3000);
+}
+
+TEST(patricia, uint64_against_scan)
+{
+    check_against_scan<std::uint64_t>(2000, 3000);
+}
+
+TEST(patricia, ipv6_against_scan)
+{
+    check_against_scan<radix_uint128>(2000, 3000);
+}
+
+TEST(patricia, routing_table)
+{
+    ipv4_radix_tree<std::string> table;
+    table.insert(0, 0, "default");
+    table.insert(0x0a000000, 8, "10/8");
+    table.insert(0x0a010000, 16, "10.1/16");
+    table.insert(0x0a010203, 32, "10.1.2.3/32");
+
+    ASSERT_EQ("10.1.2.3/32", *table.longest_match(0x0a010203));
+    ASSERT_EQ("10.1/16", *table.longest_match(0x0a010204));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a020304));
+    ASSERT_EQ("default", *table.longest_match(0xc0a80001));
+    // host bits of the key are ignored
+    ASSERT_EQ("10/8", *table.find(0x0a123456, 8));
+
+    ASSERT_TRUE(table.erase(0x0a010000, 16));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a010204));
+    ASSERT_EQ("10.1.2.3/32", *table.longest_match(0x0a010203));
+
+    const unsigned char v6[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+    ipv6_radix_tree<int> table6;
+    table6.insert(radix_ipv6_word(v6), 32, 1);
+    int len = 0;
+    ASSERT_EQ(1, *table6.longest_match(radix_ipv6_word(v6) | 0xffff, &len));
+    ASSERT_EQ(32, len);
+}
+
+TEST(patricia, bounded_match_and_subtree)
+{
+    ipv4_radix_tree<int> table;
+    table.insert(0x0a000000, 8, 8);
+    table.insert(0x0a010000, 16, 16);
+    table.insert(0x0a010200, 24, 24);
+    table.insert(0x0a010280, 25, 25);
+    table.insert(0x0b000000, 8, 11);
+
+    int len = 0;
+    ASSERT_EQ(24, *table.longest_match_upto(0x0a0102ff, 24, &len));
+    ASSERT_EQ(24, len);
+    ASSERT_EQ(16, *table.longest_match_upto(0x0a0102ff, 23));
+    ASSERT_TRUE(table.longest_match_upto(0x0a0102ff, 7) == NULL);
+
+    std::vector<int> within;
+    table.for_each_within(0x0a010000, 16, [&](std::uint32_t, int, int value) { within.push_back(value); });
+    ASSERT_EQ((std::vector<int>{ 16, 24, 25 }), within);
+
+    within.clear();
+    table.for_each_within(0x0a010280, 26, [&](std::uint32_t, int, int value) { within.push_back(value); });
+    ASSERT_TRUE(within.empty());
+    table.for_each_within(0x0a000000, 7, [&](std::uint32_t, int, int value) { within.push_back(value); });
+    ASSERT_EQ((std::vector<int>{ 8, 16, 24, 25, 11 }), within);
+}
+
+// a failed insert, whichever allocation fails, leaves the table as it was
+TEST(patricia, failed_insert)
+{
+    ipv4_radix_tree<int> table;
+    table.insert(0x0a010000, 16, 16);
+
+    const std::uint32_t addrs[] = { 0x0a000000, 0x0a020000, 0x0a010100, 0x0b000000 };
+    const int           lens[]  = { 8,          16,         24,         8 };
+
+    for (int i = 0; i < 4; i++) {
+        for (long fail = 0; ; fail++) {
+            long live = g_live_allocations;
+            bool done = false;
+
+            g_allocations_left = fail;
+            try {
+                table.insert(addrs[i], lens[i], lens[i]);
+                done = true;
+            } catch (const std::bad_alloc&) {
+            }
+            g_allocations_left = -1;
+
+            if (done)
+                break;
+            ASSERT_EQ(live, g_live_allocations);
+            ASSERT_TRUE(table.find(addrs[i], lens[i]) == NULL);
+        }
+        ASSERT_EQ(lens[i], *table.find(addrs[i], lens[i]));
+    }
+    ASSERT_EQ(5u, table.size());
+}
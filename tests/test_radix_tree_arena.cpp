@@ -0,0 +1,79 @@
+#include "common.hpp"
+
+#include <radix_tree_arena.hpp>
+
+typedef radix_tree_arena_allocator<std::pair<const std::string, int> > arena_alloc_t;
+typedef radix_tree<std::string, int, std::less<std::string>, arena_alloc_t> arena_tree_t;
+
+TEST(arena, insert_find_erase)
+{
+    radix_tree_arena arena;
+    arena_tree_t tree((arena_alloc_t(arena)));
+    std::map<std::string, int> map;
+
+    for (int i = 0; i < 5000; i++) {
+        std::string key;
+        int len = rand() % 6;
+        for (int j = 0; j < len; j++)
+            key += static_cast<char>('a' + rand() % 20);
+        tree[key] = i;
+        map[key] = i;
+    }
+    ASSERT_EQ(map.size(), tree.size());
+    ASSERT_GT(arena.slab_count(), 0u);
+
+    int n = 0;
+    for (std::map<std::string, int>::iterator it = map.begin(); it != map.end(); ++it, n++) {
+        ASSERT_EQ(it->second, tree.find(it->first)->second);
+        if (n % 2 == 0) {
+            ASSERT_TRUE(tree.erase(it->first));
+        }
+    }
+    n = 0;
+    for (std::map<std::string, int>::iterator it = map.begin(); it != map.end(); ++it, n++) {
+        if (n % 2 == 0) {
+            ASSERT_TRUE(tree.find(it->first) == tree.end());
+        } else {
+            ASSERT_EQ(it->second, tree.find(it->first)->second);
+        }
+    }
+}
+
+TEST(arena, clear_releases_slabs)
+{
+    radix_tree_arena arena(4096);
+    arena_tree_t tree((arena_alloc_t(arena)));
+
+    for (int i = 0; i < 10000; i++)
+        tree[std::to_string(i * 7919)] = i;
+    ASSERT_GT(arena.slab_count(), 1u);
+
+    tree.clear();
+    ASSERT_EQ(0u, tree.size());
+    ASSERT_EQ(0u, arena.slab_count());
+    ASSERT_EQ(0u, arena.bytes_reserved());
+
+    tree["reused"] = 1;
+    ASSERT_EQ(1, tree.find("reused")->second);
+}
+
+TEST(arena, shared_arena_is_not_released)
+{
+    radix_tree_arena arena;
+    arena_tree_t tree1((arena_alloc_t(arena)));
+    {
+        arena_tree_t tree2((arena_alloc_t(arena)));
+        ASSERT_EQ(2u, arena.users());
+
+        for (int i = 0; i < 1000; i++) {
+            tree1[std::to_string(i)] = i;
+            tree2[std::to_string(-i)] = i;
+        }
+        tree2.clear();
+        ASSERT_GT(arena.slab_count(), 0u);
+    }
+    ASSERT_EQ(1u, arena.users());
+
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQ(i, tree1.find(std::to_string(i))->second);
+}
@@ -0,0 +1,212 @@
+#include "common.hpp"
+
+#include <radix_tree_children.hpp>
+
+struct dummy_node { int id; };
+typedef radix_tree_art_index<dummy_node> art_index_t;
+
+TEST(art_index, grow_and_shrink)
+{
+    std::vector<dummy_node> nodes(256);
+    std::vector<int> bytes;
+    for (int i = 0; i < 256; i++) {
+        nodes[i].id = i;
+        bytes.push_back(i);
+    }
+    std::random_shuffle(bytes.begin(), bytes.end());
+
+    std::allocator<dummy_node> alloc;
+    art_index_t index;
+    ASSERT_EQ(-1, index.kind());
+    for (size_t i = 0; i < bytes.size(); i++) {
+        index.insert(static_cast<unsigned char>(bytes[i]), &nodes[bytes[i]], alloc);
+        ASSERT_EQ(i + 1, index.size());
+        if (i + 1 <= 4)
+            ASSERT_EQ(art_index_t::node4, index.kind());
+        else if (i + 1 <= 16)
+            ASSERT_EQ(art_index_t::node16, index.kind());
+        else if (i + 1 <= 48)
+            ASSERT_EQ(art_index_t::node48, index.kind());
+        else
+            ASSERT_EQ(art_index_t::node256, index.kind());
+        for (size_t j = 0; j <= i; j++)
+            ASSERT_EQ(&nodes[bytes[j]], index.find(static_cast<unsigned char>(bytes[j])));
+    }
+
+    std::random_shuffle(bytes.begin(), bytes.end());
+    for (size_t i = 0; i < bytes.size(); i++) {
+        index.erase(static_cast<unsigned char>(bytes[i]), alloc);
+        ASSERT_EQ(NULL, index.find(static_cast<unsigned char>(bytes[i])));
+        ASSERT_EQ(bytes.size() - i - 1, index.size());
+        for (size_t j = i + 1; j < bytes.size(); j++)
+            ASSERT_EQ(&nodes[bytes[j]], index.find(static_cast<unsigned char>(bytes[j])));
+    }
+    ASSERT_EQ(-1, index.kind());
+}
+
+TEST(art_index, ordered_walk)
+{
+    std::vector<dummy_node> nodes(256);
+    std::allocator<dummy_node> alloc;
+    for (int count = 1; count <= 256; count *= 2) {
+        art_index_t index;
+        std::vector<int> bytes;
+        for (int i = 0; i < count; i++) {
+            int byte = (i * 97 + 13) % 256;
+            nodes[byte].id = byte;
+            bytes.push_back(byte);
+            index.insert(static_cast<unsigned char>(byte), &nodes[byte], alloc);
+        }
+        std::sort(bytes.begin(), bytes.end());
+
+        std::vector<int> walked;
+        for (dummy_node *n = index.first(); n != NULL; n = index.next(static_cast<unsigned char>(n->id)))
+            walked.push_back(n->id);
+        ASSERT_EQ(bytes, walked);
+        index.release(alloc);
+    }
+}
+
+TEST(art_index, replace_in_place)
+{
+    std::vector<dummy_node> nodes(256), others(256);
+    std::allocator<dummy_node> alloc;
+    for (int count : { 1, 4, 16, 48, 256 }) {
+        art_index_t index;
+        for (int i = 0; i < count; i++)
+            index.insert(static_cast<unsigned char>(i), &nodes[i], alloc);
+        int kind = index.kind();
+
+        for (int i = 0; i < count; i++)
+            index.replace(static_cast<unsigned char>(i), &others[i]);
+
+        // neither the size nor the layout change
+        ASSERT_EQ(static_cast<size_t>(count), index.size());
+        ASSERT_EQ(kind, index.kind());
+        for (int i = 0; i < count; i++)
+            ASSERT_EQ(&others[i], index.find(static_cast<unsigned char>(i)));
+        index.release(alloc);
+    }
+}
+
+TEST(art_index, failed_relayout)
+{
+    typedef radix_tree_art_index<dummy_node, failing_allocator<dummy_node> > failing_index_t;
+
+    std::vector<dummy_node> nodes(256);
+    failing_allocator<dummy_node> alloc;
+    failing_index_t index;
+
+    // a full table that cannot grow keeps what it has
+    for (int count : { 4, 16, 48 }) {
+        while (index.size() < static_cast<size_t>(count))
+            index.insert(static_cast<unsigned char>(index.size()), &nodes[index.size()], alloc);
+        int kind = index.kind();
+
+        allocations_left = 0;
+        ASSERT_THROW(index.insert(static_cast<unsigned char>(count), &nodes[count], alloc), std::bad_alloc);
+        allocations_left = -1;
+
+        ASSERT_EQ(kind, index.kind());
+        ASSERT_EQ(static_cast<size_t>(count), index.size());
+        for (int i = 0; i < count; i++)
+            ASSERT_EQ(&nodes[i], index.find(static_cast<unsigned char>(i)));
+    }
+
+    // one that cannot shrink stays larger
+    allocations_left = 0;
+    for (int i = 47; i > 0; i--) {
+        index.erase(static_cast<unsigned char>(i), alloc);
+        ASSERT_EQ(static_cast<size_t>(i), index.size());
+        for (int j = 0; j < i; j++)
+            ASSERT_EQ(&nodes[j], index.find(static_cast<unsigned char>(j)));
+    }
+    allocations_left = -1;
+    ASSERT_EQ(failing_index_t::node48, index.kind());
+    index.release(alloc);
+}
+
+TEST(children, iteration_order_matches_map)
+{
+    tree_t tree;
+    std::map<std::string, int> map;
+    for (int i = 0; i < 2000; i++) {
+        std::string key;
+        int len = rand() % 4;
+        for (int j = 0; j < len; j++)
+            key += static_cast<char>(rand() % 256);
+        tree[key] = i;
+        map[key] = i;
+    }
+    for (int i = 0; i < 1000; i++) {
+        std::map<std::string, int>::iterator it = map.begin();
+        std::advance(it, rand() % map.size());
+        ASSERT_TRUE(tree.erase(it->first));
+        map.erase(it);
+    }
+
+    std::map<std::string, int>::iterator expected = map.begin();
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++expected) {
+        ASSERT_NE(map.end(), expected);
+        ASSERT_EQ(expected->first, it->first);
+        ASSERT_EQ(expected->second, it->second);
+    }
+    ASSERT_EQ(map.end(), expected);
+}
+
+// byte vector keys for the signed order tests
+#define RADIX_VECTOR_KEY(E) \
+    template<> \
+    std::vector<E> radix_substr<std::vector<E> >(const std::vector<E> &key, int begin, int num) \
+    { return std::vector<E>(key.begin() + begin, key.begin() + begin + num); } \
+    template<> \
+    std::vector<E> radix_join<std::vector<E> >(const std::vector<E> &key1, const std::vector<E> &key2) \
+    { std::vector<E> key(key1); key.insert(key.end(), key2.begin(), key2.end()); return key; } \
+    template<> \
+    int radix_length<std::vector<E> >(const std::vector<E> &key) \
+    { return static_cast<int>(key.size()); }
+
+RADIX_VECTOR_KEY(signed char)
+RADIX_VECTOR_KEY(char)
+
+// signed elements order below zero first, which byte tables would not
+template <typename E>
+static void check_signed_order()
+{
+    typedef std::vector<E> key_t;
+    const int heads[] = { -5, 3, -100, 50, 0, -1, 127 };
+
+    radix_tree<key_t, int> tree;
+    std::map<key_t, int> map;
+    for (int i = 0; i < 7; i++) {
+        for (int len = 1; len <= 3; len++) {
+            key_t key(len, static_cast<E>(heads[i]));
+            key[len - 1] = static_cast<E>(heads[(i + len) % 7]);
+            tree[key] = i;
+            map[key] = i;
+        }
+    }
+
+    typename std::map<key_t, int>::iterator expected = map.begin();
+    for (typename radix_tree<key_t, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++expected) {
+        ASSERT_NE(map.end(), expected);
+        ASSERT_EQ(expected->first, it->first);
+    }
+    ASSERT_EQ(map.end(), expected);
+}
+
+TEST(children, signed_elements)
+{
+    static_assert(! radix_tree_adaptive_nodes<std::vector<signed char>, std::less<std::vector<signed char> > >::value, "signed bytes keep Compare order");
+    static_assert(radix_tree_adaptive_nodes<std::vector<unsigned char>, std::less<std::vector<unsigned char> > >::value, "unsigned bytes index directly");
+    static_assert(radix_tree_adaptive_nodes<std::string, std::less<std::string> >::value, "strings compare as unsigned");
+
+    {
+        SCOPED_TRACE("signed char");
+        check_signed_order<signed char>();
+    }
+    {
+        SCOPED_TRACE("char");
+        check_signed_order<char>();
+    }
+}
@@ -0,0 +1,165 @@
+#include "common.hpp"
+
+#include <random>
+
+#include <radix_tree_arena.hpp>
+
+typedef radix_tree<std::string, int, std::less<std::string>, radix_tree_arena_allocator<std::pair<const std::string, int> > > arena_tree_t;
+
+static std::vector<std::string> churn_keys(int count)
+{
+    std::mt19937 rng(7);
+    std::vector<std::string> keys;
+
+    for (int i = 0; i < count; i++)
+        keys.push_back("/srv/" + std::to_string(rng() % 50) + "/data/" + std::to_string(rng()));
+    return keys;
+}
+
+// inserts keys, erases every third and returns what is left
+template <typename Tree>
+std::map<std::string, int> churn(Tree &tree, const std::vector<std::string> &keys)
+{
+    std::map<std::string, int> expected;
+
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        tree[keys[i]] = static_cast<int>(i);
+        expected[keys[i]] = static_cast<int>(i);
+    }
+    for (std::size_t i = 0; i < keys.size(); i += 3) {
+        tree.erase(keys[i]);
+        expected.erase(keys[i]);
+    }
+    return expected;
+}
+
+template <typename Tree>
+void expect_entries(const Tree &tree, const std::map<std::string, int> &expected)
+{
+    ASSERT_EQ(expected.size(), tree.size());
+
+    typename Tree::const_iterator it = tree.begin();
+    for (std::map<std::string, int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it) {
+        ASSERT_NE(tree.end(), it);
+        ASSERT_EQ(e->first, it->first);
+        ASSERT_EQ(e->second, it->second);
+        ASSERT_EQ(it, tree.find(e->first));
+    }
+    ASSERT_EQ(tree.end(), it);
+}
+
+TEST(compact, keeps_entries)
+{
+    tree_t tree;
+    tree.compact();
+    ASSERT_TRUE(tree.empty());
+
+    std::map<std::string, int> expected = churn(tree, churn_keys(5000));
+    radix_tree_stats before = tree.stats();
+
+    tree.compact();
+    expect_entries(tree, expected);
+
+    // the shape is kept, value storage left over by erase is dropped
+    radix_tree_stats after = tree.stats();
+    ASSERT_EQ(before.nodes, after.nodes);
+    ASSERT_EQ(before.depth, after.depth);
+    ASSERT_EQ(before.fanout, after.fanout);
+    ASSERT_EQ(before.label_bytes, after.label_bytes);
+    ASSERT_EQ(tree.size(), after.value_nodes);
+
+    // and the tree keeps working
+    tree["/srv/new"] = -1;
+    ASSERT_TRUE(tree.erase(expected.begin()->first));
+    ASSERT_EQ(-1, tree.find("/srv/new")->second);
+}
+
+TEST(compact, root_with_value)
+{
+    tree_t tree;
+    tree[""]  = 1;
+    tree["a"] = 2;
+
+    tree.compact();
+    ASSERT_EQ(2u, tree.size());
+    ASSERT_EQ(1, tree.find("")->second);
+    ASSERT_EQ(2, tree.find("a")->second);
+}
+
+TEST(compact, arena)
+{
+    radix_tree_arena arena(16 * 1024);
+    arena_tree_t tree(arena);
+
+    std::map<std::string, int> expected = churn(tree, churn_keys(5000));
+    std::size_t reserved = arena.bytes_reserved();
+
+    tree.compact();
+    expect_entries(tree, expected);
+    // the old slabs are gone and the nodes fill new ones
+    ASSERT_LE(arena.bytes_reserved(), reserved);
+
+    tree.compact();
+    expect_entries(tree, expected);
+
+    tree.clear();
+    ASSERT_EQ(0u, arena.bytes_reserved());
+}
+
+TEST(compact, shared_arena)
+{
+    radix_tree_arena arena;
+    arena_tree_t a(arena);
+    arena_tree_t b(arena);
+
+    std::map<std::string, int> expected_a = churn(a, churn_keys(500));
+    b["x"] = 1;
+
+    a.compact();
+    expect_entries(a, expected_a);
+    ASSERT_EQ(1, b.find("x")->second);
+}
+
+TEST(compact, map_layout)
+{
+    radix_tree<std::string, int, greater_string> tree;
+    std::vector<std::string> keys = churn_keys(1000);
+
+    for (std::size_t i = 0; i < keys.size(); i++)
+        tree[keys[i]] = static_cast<int>(i);
+
+    tree.compact();
+    ASSERT_EQ(keys.size(), tree.size());
+    for (std::size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(static_cast<int>(i), tree.find(keys[i])->second);
+    ASSERT_TRUE(std::is_sorted(tree.begin(), tree.end(), [](const auto &a, const auto &b) { return a.first > b.first; }));
+}
+
+TEST(compact, move_only_values)
+{
+    radix_tree<std::string, std::unique_ptr<int> > tree;
+    tree["abc"].reset(new int(1));
+    tree["abd"].reset(new int(2));
+
+    tree.compact();
+    ASSERT_EQ(1, *tree.find("abc")->second);
+    ASSERT_EQ(2, *tree.find("abd")->second);
+}
+
+TEST(compact, failing_allocation_leaves_tree)
+{
+    typedef radix_tree<std::string, int, std::less<std::string>, failing_allocator<std::pair<const std::string, int> > > failing_tree_t;
+
+    failing_tree_t tree;
+    std::map<std::string, int> expected = churn(tree, churn_keys(300));
+
+    for (long n : { 0L, 1L, 10L, 100L }) {
+        allocations_left = n;
+        ASSERT_THROW(tree.compact(), std::bad_alloc);
+        allocations_left = -1;
+        expect_entries(tree, expected);
+    }
+
+    tree.compact();
+    expect_entries(tree, expected);
+}
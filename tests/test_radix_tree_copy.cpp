@@ -0,0 +1,227 @@
+#include "common.hpp"
+
+#include <memory>
+#include <random>
+
+#include <radix_tree_arena.hpp>
+
+typedef radix_tree<std::string, int, std::less<std::string>, radix_tree_arena_allocator<std::pair<const std::string, int> > > arena_tree_t;
+
+// a failing_allocator that equals only allocators with the same tag and
+// stays with its tree on assignment
+template <typename T>
+struct tagged_allocator : failing_allocator<T> {
+    typedef std::false_type propagate_on_container_move_assignment;
+    typedef std::false_type is_always_equal;
+    template <typename U>
+    struct rebind { typedef tagged_allocator<U> other; };
+
+    int tag;
+
+    tagged_allocator(int t = 0) : tag(t) { }
+    template <typename U>
+    tagged_allocator(const tagged_allocator<U> &other) : tag(other.tag) { }
+
+    template <typename U>
+    bool operator== (const tagged_allocator<U> &rhs) const { return tag == rhs.tag; }
+    template <typename U>
+    bool operator!= (const tagged_allocator<U> &rhs) const { return tag != rhs.tag; }
+};
+
+typedef radix_tree<std::string, int, std::less<std::string>, tagged_allocator<std::pair<const std::string, int> > > tagged_tree_t;
+
+static std::map<std::string, int> fill(tree_t &tree, int count)
+{
+    std::mt19937 rng(3);
+    std::map<std::string, int> expected;
+
+    for (int i = 0; i < count; i++) {
+        std::string key = "k/" + std::to_string(rng() % 97) + "/" + std::to_string(rng());
+        tree[key] = i;
+        expected[key] = i;
+    }
+    return expected;
+}
+
+template <typename Tree>
+void expect_entries(const Tree &tree, const std::map<std::string, int> &expected)
+{
+    ASSERT_EQ(expected.size(), tree.size());
+
+    typename Tree::const_iterator it = tree.begin();
+    for (std::map<std::string, int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it) {
+        ASSERT_NE(tree.end(), it);
+        ASSERT_EQ(e->first, it->first);
+        ASSERT_EQ(e->second, it->second);
+        ASSERT_EQ(it, tree.find(e->first));
+    }
+    ASSERT_EQ(tree.end(), it);
+}
+
+static tree_t make_tree()
+{
+    tree_t tree;
+    tree["returned"] = 1;
+    return tree;
+}
+
+TEST(copy, deep_and_independent)
+{
+    tree_t tree;
+    std::map<std::string, int> expected = fill(tree, 3000);
+
+    tree_t copy(tree);
+    expect_entries(copy, expected);
+    ASSERT_EQ(tree.stats().nodes, copy.stats().nodes);
+
+    copy.erase(expected.begin()->first);
+    copy["k/new"] = -1;
+    tree.begin()->second = 12345;
+
+    std::map<std::string, int> changed = expected;
+    changed.begin()->second = 12345;
+    expect_entries(tree, changed);
+
+    ASSERT_EQ(expected.size(), copy.size());
+    ASSERT_EQ(copy.end(), copy.find(expected.begin()->first));
+    ASSERT_EQ(expected.rbegin()->second, copy.find(expected.rbegin()->first)->second);
+
+    tree_t empty;
+    tree_t empty_copy(empty);
+    ASSERT_TRUE(empty_copy.empty());
+    empty_copy["a"] = 1;
+    ASSERT_EQ(1u, empty_copy.size());
+}
+
+TEST(copy, assignment)
+{
+    tree_t tree;
+    std::map<std::string, int> expected = fill(tree, 500);
+
+    tree_t other;
+    other["old"] = 1;
+    other = tree;
+    expect_entries(other, expected);
+
+    other = other;
+    expect_entries(other, expected);
+
+    other = tree_t();
+    ASSERT_TRUE(other.empty());
+    expect_entries(tree, expected);
+}
+
+TEST(copy, move)
+{
+    tree_t tree;
+    std::map<std::string, int> expected = fill(tree, 500);
+    tree_t::iterator first = tree.begin();
+
+    tree_t moved(std::move(tree));
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.end(), tree.begin());
+    expect_entries(moved, expected);
+    // the nodes were handed over, not copied
+    ASSERT_EQ(first, moved.begin());
+
+    tree_t assigned;
+    assigned["x"] = 1;
+    assigned = std::move(moved);
+    ASSERT_TRUE(moved.empty());
+    expect_entries(assigned, expected);
+    ASSERT_EQ(first, assigned.begin());
+
+    // moved-from trees are usable
+    moved["again"] = 2;
+    ASSERT_EQ(2, moved.find("again")->second);
+
+    tree_t returned = make_tree();
+    ASSERT_EQ(1, returned.find("returned")->second);
+}
+
+TEST(copy, swap)
+{
+    tree_t a, b;
+    std::map<std::string, int> expected = fill(a, 100);
+    b["b"] = 1;
+
+    swap(a, b);
+    expect_entries(b, expected);
+    ASSERT_EQ(1u, a.size());
+    ASSERT_EQ(1, a.find("b")->second);
+}
+
+TEST(copy, in_containers)
+{
+    std::vector<tree_t> trees;
+    for (int i = 0; i < 20; i++) {
+        trees.push_back(tree_t());
+        trees.back()[std::to_string(i)] = i;
+    }
+    for (int i = 0; i < 20; i++)
+        ASSERT_EQ(i, trees[i].find(std::to_string(i))->second);
+
+    std::vector<tree_t> copies(trees);
+    trees.clear();
+    ASSERT_EQ(7, copies[7].find("7")->second);
+}
+
+TEST(copy, move_only_values)
+{
+    typedef radix_tree<std::string, std::unique_ptr<int> > ptr_tree_t;
+    ptr_tree_t tree;
+    tree["a"].reset(new int(1));
+
+    ptr_tree_t moved(std::move(tree));
+    ptr_tree_t assigned;
+    assigned = std::move(moved);
+    ASSERT_EQ(1, *assigned.find("a")->second);
+}
+
+TEST(copy, arenas)
+{
+    radix_tree_arena arena1, arena2;
+    arena_tree_t a(arena1);
+    for (int i = 0; i < 200; i++)
+        a["key" + std::to_string(i)] = i;
+
+    // a copy shares the arena, a move between arenas moves the entries
+    arena_tree_t copy(a);
+    ASSERT_EQ(2u, arena1.users());
+    ASSERT_EQ(a.size(), copy.size());
+
+    arena_tree_t b(arena2);
+    b = std::move(copy);
+    ASSERT_TRUE(copy.empty());
+    ASSERT_EQ(&arena2, b.get_allocator().arena());
+    for (int i = 0; i < 200; i++)
+        ASSERT_EQ(i, b.find("key" + std::to_string(i))->second);
+
+    arena_tree_t c(arena1);
+    c = std::move(a);
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(200u, c.size());
+}
+
+TEST(copy, failed_move_between_allocators)
+{
+    tagged_tree_t a(tagged_allocator<std::pair<const std::string, int> >(1));
+    tagged_tree_t b(tagged_allocator<std::pair<const std::string, int> >(2));
+    for (int i = 0; i < 100; i++)
+        a["a" + std::to_string(i)] = i;
+    b["kept"] = 1;
+
+    // the new nodes run out halfway, b keeps its entries
+    allocations_left = 50;
+    ASSERT_THROW(b = std::move(a), std::bad_alloc);
+    allocations_left = -1;
+    ASSERT_EQ(1u, b.size());
+    ASSERT_EQ(1, b.find("kept")->second);
+
+    b = std::move(a);
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(100u, b.size());
+    ASSERT_EQ(2, b.get_allocator().tag);
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(i, b.find("a" + std::to_string(i))->second);
+}
@@ -0,0 +1,109 @@
+#define RADIX_TREE_INSTRUMENT
+#include "common.hpp"
+
+static radix_tree_counters counted(const std::function<void()> &f)
+{
+    radix_tree_counters before = radix_tree_thread_counters();
+    f();
+    return radix_tree_thread_counters() - before;
+}
+
+TEST(counters, lookup)
+{
+    tree_t tree;
+    tree["abcdef"] = 1;
+    tree["abcxyz"] = 2;
+    tree["q"]      = 3;
+
+    // root -> "abc" -> "def"
+    radix_tree_counters c = counted([&]() { ASSERT_NE(tree.end(), tree.find("abcdef")); });
+    ASSERT_EQ(1u, c[radix_tree_counters::lookups]);
+    ASSERT_EQ(3u, c[radix_tree_counters::nodes_visited]);
+    ASSERT_EQ(6u, c[radix_tree_counters::label_bytes]);
+    ASSERT_EQ(0u, c[radix_tree_counters::allocations]);
+
+    // stops at the first differing byte of "def"
+    c = counted([&]() { ASSERT_EQ(tree.end(), tree.find("abcdxx")); });
+    ASSERT_EQ(3u, c[radix_tree_counters::nodes_visited]);
+    ASSERT_EQ(5u, c[radix_tree_counters::label_bytes]);
+
+    c = counted([&]() { ASSERT_EQ("q", tree.longest_match("qqq")->first); });
+    ASSERT_EQ(1u, c[radix_tree_counters::lookups]);
+    ASSERT_EQ(2u, c[radix_tree_counters::nodes_visited]);
+}
+
+TEST(counters, split_and_merge)
+{
+    tree_t tree;
+    tree["abcdef"] = 1;
+
+    radix_tree_counters c = counted([&]() { tree["abcxyz"] = 2; });
+    ASSERT_EQ(1u, c[radix_tree_counters::lookups]);
+    ASSERT_EQ(1u, c[radix_tree_counters::splits]);
+    ASSERT_EQ(0u, c[radix_tree_counters::merges]);
+    // the split node, its child table and the new leaf; the parent's table
+    // is updated in place
+    ASSERT_EQ(3u, c[radix_tree_counters::allocations]);
+
+    c = counted([&]() { tree["abcdefg"] = 3; });
+    ASSERT_EQ(0u, c[radix_tree_counters::splits]);
+
+    c = counted([&]() { ASSERT_TRUE(tree.erase("abcxyz")); });
+    ASSERT_EQ(1u, c[radix_tree_counters::merges]);
+    ASSERT_EQ(0u, c[radix_tree_counters::allocations]);
+
+    c = counted([&]() { tree.erase(tree.find("abcdefg")); });
+    ASSERT_EQ(0u, c[radix_tree_counters::merges]);
+}
+
+TEST(counters, long_labels_read_once)
+{
+    // a chain of 8-byte labels: descents compare their heads and read the
+    // whole key once at the bottom, never walking below each level
+    std::string chain;
+    for (int i = 0; i < 8 * 200; i++)
+        chain += static_cast<char>('a' + i % 26);
+
+    tree_t tree;
+    for (int i = 1; i <= 200; i++)
+        tree[chain.substr(0, 8 * i) + "~"] = i;
+
+    std::string key = chain + "~";
+    radix_tree_counters c = counted([&]() { ASSERT_NE(tree.end(), tree.find(key)); });
+    ASSERT_LE(c[radix_tree_counters::nodes_visited], 2 * 200u + 2);
+    ASSERT_LE(c[radix_tree_counters::label_bytes], 4 * 200u + key.size() + 1);
+
+    key[8 * 100 + 5] = '#';
+    c = counted([&]() { ASSERT_EQ(tree.end(), tree.find(key)); });
+    ASSERT_LE(c[radix_tree_counters::nodes_visited], 2 * 200u + 2);
+}
+
+TEST(counters, iterator)
+{
+    tree_t tree;
+    std::vector<std::string> keys = get_unique_keys();
+    for (const std::string &key : keys)
+        tree[key] = 0;
+
+    radix_tree_counters c = counted([&]() {
+        for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it)
+            ;
+    });
+    ASSERT_EQ(keys.size(), c[radix_tree_counters::iterator_steps]);
+    ASSERT_GE(c[radix_tree_counters::nodes_visited], keys.size());
+    ASSERT_EQ(0u, c[radix_tree_counters::lookups]);
+}
+
+TEST(counters, per_thread)
+{
+    tree_t tree;
+    tree["abc"] = 1;
+
+    radix_tree_counters mine = radix_tree_thread_counters();
+    std::thread([&]() {
+        tree.find("abc");
+        ASSERT_EQ(1u, radix_tree_thread_counters()[radix_tree_counters::lookups]);
+    }).join();
+
+    ASSERT_EQ(0u, (radix_tree_thread_counters() - mine)[radix_tree_counters::lookups]);
+}
@@ -128,3 +128,217 @@ TEST(erase, empty_key)
         }
     }
 }
+
+TEST(erase, branching_key)
+{
+    tree_t tree;
+    tree["ab"] = 1;
+    tree["abc"] = 2;
+    tree["abd"] = 3;
+
+    ASSERT_TRUE(tree.erase("ab"));
+    ASSERT_EQ(tree.end(), tree.find("ab"));
+    ASSERT_EQ(2, tree.find("abc")->second);
+    ASSERT_EQ(3, tree.find("abd")->second);
+
+    tree["ab"] = 4;
+    ASSERT_EQ(4, tree.find("ab")->second);
+    ASSERT_TRUE(tree.erase("abc"));
+    ASSERT_TRUE(tree.erase("ab"));
+    ASSERT_EQ(3, tree.find("abd")->second);
+    ASSERT_EQ(1u, tree.size());
+}
+
+TEST(erase, long_labels_read_from_remaining_keys)
+{
+    // long edge labels are read from a key below them, which erase may free
+    tree_t tree;
+    const std::string stem = "/usr/share/documentation/";
+    const char *leaves[] = { "alpha/readme.txt", "alpha/license.txt", "beta/readme.txt", "beta/changes.txt", "gamma" };
+    const int count = sizeof(leaves) / sizeof(leaves[0]);
+
+    for (int i = 0; i < count; i++)
+        tree[stem + leaves[i]] = i;
+    tree[stem] = -1;
+
+    for (int i = 0; i < count; i++) {
+        ASSERT_TRUE(tree.erase(stem + leaves[i]));
+        for (int j = i + 1; j < count; j++)
+            ASSERT_EQ(j, tree.find(stem + leaves[j])->second);
+        ASSERT_EQ(tree.end(), tree.find(stem + leaves[i]));
+        ASSERT_EQ(-1, tree.longest_match(stem + leaves[i])->second);
+    }
+    ASSERT_TRUE(tree.erase(stem));
+    ASSERT_EQ(0u, tree.size());
+}
+
+TEST(erase, by_iterator_returns_next)
+{
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (size_t i = 0; i < unique_keys.size(); i++) {
+        tree_t tree;
+        std::map<std::string, int> expected;
+        for (size_t j = 0; j < unique_keys.size(); j++) {
+            tree[unique_keys[j]] = static_cast<int>(j);
+            expected[unique_keys[j]] = static_cast<int>(j);
+        }
+
+        // erase every other entry, starting at a different one each round
+        tree_t::iterator it = tree.begin();
+        std::map<std::string, int>::iterator e = expected.begin();
+        for (size_t j = 0; j < i; j++, ++it, ++e)
+            ;
+        while (it != tree.end()) {
+            ASSERT_EQ(e->first, it->first);
+            std::string key = it->first;
+            it = tree.erase(it);
+            e = expected.erase(e);
+            ASSERT_EQ(tree.end(), tree.find(key));
+            if (it == tree.end())
+                break;
+            ASSERT_EQ(e->first, it->first);
+            ++it;
+            ++e;
+        }
+
+        ASSERT_EQ(expected.size(), tree.size());
+        for (e = expected.begin(); e != expected.end(); ++e)
+            ASSERT_EQ(e->second, tree.find(e->first)->second);
+    }
+}
+
+TEST(erase, iterator_range)
+{
+    std::vector<std::string> unique_keys = get_unique_keys();
+    tree_t tree;
+    for (size_t i = 0; i < unique_keys.size(); i++)
+        tree[unique_keys[i]] = static_cast<int>(i);
+
+    tree_t::range ab = tree.prefix_range("ab");
+    tree_t::iterator next = tree.erase(ab.begin(), ab.end());
+    ASSERT_EQ(ab.end(), next);
+    ASSERT_EQ("b", next->first);
+    ASSERT_EQ(tree.end(), tree.find("abb"));
+    ASSERT_EQ(unique_keys.size() - 3, tree.size());
+
+    ASSERT_EQ(tree.end(), tree.erase(tree.cbegin(), tree.cend()));
+    ASSERT_TRUE(tree.empty());
+}
+
+TEST(erase, remove_if)
+{
+    tree_t tree;
+    std::map<std::string, int> expected;
+    const std::string stem = "/var/spool/sessions/";
+    for (int i = 0; i < 2000; i++) {
+        std::string key = stem + std::to_string(i * 7919 % 10007);
+        tree[key] = i;
+        expected[key] = i;
+    }
+
+    size_t erased = tree.remove_if([](const std::string &key) { return key[key.size() - 1] < '2'; });
+
+    size_t expected_erased = 0;
+    for (std::map<std::string, int>::iterator it = expected.begin(); it != expected.end(); ) {
+        if (it->first[it->first.size() - 1] < '2') {
+            it = expected.erase(it);
+            expected_erased++;
+        } else {
+            ++it;
+        }
+    }
+
+    ASSERT_EQ(expected_erased, erased);
+    ASSERT_EQ(expected.size(), tree.size());
+    std::map<std::string, int>::iterator e = expected.begin();
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++e) {
+        ASSERT_EQ(e->first, it->first);
+        ASSERT_EQ(e->second, it->second);
+    }
+
+    ASSERT_EQ(expected.size(), tree.remove_if([](const std::string&) { return true; }));
+    ASSERT_TRUE(tree.empty());
+    tree["x"] = 1;
+    ASSERT_EQ(1, tree.find("x")->second);
+}
+
+TEST(erase, prefix)
+{
+    tree_t tree;
+    std::map<std::string, int> expected;
+    const char *tenants[] = { "acme/", "acme-labs/", "beta/", "" };
+    for (int t = 0; t < 4; t++) {
+        for (int i = 0; i < 50; i++) {
+            std::string key = std::string(tenants[t]) + "objects/" + std::to_string(i);
+            tree[key] = i;
+            expected[key] = i;
+        }
+    }
+    tree["acme"] = -1;
+    expected["acme"] = -1;
+
+    ASSERT_EQ(0u, tree.erase_prefix("zeta/"));
+    ASSERT_EQ(50u, tree.erase_prefix("acme/"));
+    // the erased subtree hung below "acme"; its sibling is still reachable
+    ASSERT_EQ(50u, tree.erase_prefix("acme-"));
+    for (std::map<std::string, int>::iterator it = expected.begin(); it != expected.end(); ) {
+        if (it->first.compare(0, 5, "acme/") == 0 || it->first.compare(0, 5, "acme-") == 0)
+            it = expected.erase(it);
+        else
+            ++it;
+    }
+
+    ASSERT_EQ(expected.size(), tree.size());
+    std::map<std::string, int>::iterator e = expected.begin();
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++e)
+        ASSERT_EQ(e->first, it->first);
+    ASSERT_EQ(-1, tree.longest_match("acme/objects/3")->second);
+
+    // a prefix ending inside an edge
+    ASSERT_EQ(50u, tree.erase_prefix("obj"));
+    ASSERT_EQ(51u, tree.size());
+    tree["acme/objects/1"] = 1;
+    ASSERT_EQ(1, tree.find("acme/objects/1")->second);
+
+    ASSERT_EQ(52u, tree.erase_prefix(""));
+    ASSERT_TRUE(tree.empty());
+}
+
+TEST(erase, extract_prefix)
+{
+    tree_t tree;
+    const std::string stem = "/srv/tenants/";
+    for (int i = 0; i < 100; i++)
+        tree[stem + (i % 2 ? "odd/" : "even/") + std::to_string(i)] = i;
+    tree[stem + "odd"] = -1;
+
+    tree_t odd = tree.extract_prefix(stem + "odd");
+    ASSERT_EQ(51u, odd.size());
+    ASSERT_EQ(50u, tree.size());
+    ASSERT_EQ(-1, odd.find(stem + "odd")->second);
+    for (int i = 0; i < 100; i++) {
+        std::string key = stem + (i % 2 ? "odd/" : "even/") + std::to_string(i);
+        tree_t &owner = i % 2 ? odd : tree;
+        tree_t &other = i % 2 ? tree : odd;
+        ASSERT_EQ(i, owner.find(key)->second);
+        ASSERT_EQ(other.end(), other.find(key));
+    }
+
+    // the new tree is a tree like any other
+    std::vector<tree_t::iterator> vec;
+    odd.prefix_match(stem + "odd/1", vec);
+    ASSERT_EQ(6u, vec.size());
+    odd["/a"] = 7;
+    ASSERT_TRUE(odd.erase(stem + "odd/1"));
+    ASSERT_EQ(51u, odd.size());
+    ASSERT_EQ(50u, odd.erase_prefix(stem));
+    ASSERT_EQ(7, odd.begin()->second);
+
+    tree_t none = tree.extract_prefix("nothing");
+    ASSERT_TRUE(none.empty());
+    tree_t all = tree.extract_prefix("");
+    ASSERT_EQ(50u, all.size());
+    ASSERT_TRUE(tree.empty());
+    tree["x"] = 1;
+    ASSERT_EQ(1u, tree.size());
+}
@@ -1,5 +1,22 @@
 #include "common.hpp"
 
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+static size_t g_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    g_allocations++;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
 TEST(find, nothing_in_empty)
 {
     std::vector<std::string> unique_keys = get_unique_keys();
@@ -47,3 +64,136 @@ TEST(find, find_after_insert_or_erase)
         }
     }
 }
+
+TEST(find, wide_fanout)
+{
+    tree_t tree;
+    std::vector<std::string> keys;
+    for (int c = 1; c < 256; c++) {
+        keys.push_back(std::string(1, static_cast<char>(c)));
+        keys.push_back(std::string(1, static_cast<char>(c)) + "tail");
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+    for (size_t i = 0; i < keys.size(); i++) {
+        tree[keys[i]] = static_cast<int>(i);
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        SCOPED_TRACE(keys[i]);
+        tree_t::iterator it = tree.find(keys[i]);
+        ASSERT_NE(tree.end(), it);
+        ASSERT_EQ(static_cast<int>(i), it->second);
+        ASSERT_EQ(tree.end(), tree.find(keys[i] + "x"));
+    }
+}
+
+TEST(find, heterogeneous_lookup_does_not_allocate)
+{
+    tree_t tree;
+    tree["apache"] = 0;
+    tree["afford"] = 1;
+    tree["affordable_housing_is_a_long_key_beyond_sso"] = 2;
+    tree["bro"] = 3;
+    tree["brother"] = 4;
+
+    size_t before = g_allocations;
+
+    ASSERT_EQ(1, tree.find("afford")->second);
+    ASSERT_EQ(2, tree.find(std::string_view("affordable_housing_is_a_long_key_beyond_sso"))->second);
+    ASSERT_EQ(tree.end(), tree.find("affordable"));
+    ASSERT_EQ(tree.end(), tree.find(std::string_view("zzz")));
+    ASSERT_EQ(4, tree.longest_match("brothers")->second);
+    ASSERT_EQ(3, tree.longest_match(std::string_view("brown"))->second);
+
+    ASSERT_EQ(before, g_allocations);
+}
+
+TEST(find, batch_matches_single_lookups)
+{
+    tree_t tree;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2000; i++) {
+        std::string key = "/" + std::to_string(rand() % 50) + "/" + std::to_string(rand() % 1000);
+        if (i % 3 == 0)
+            tree[key] = i;
+        keys.push_back(i % 7 == 0 ? key.substr(0, key.size() / 2) : key);
+    }
+    keys.push_back("");
+
+    std::vector<tree_t::iterator> found(keys.size());
+    tree.find_batch(keys, found);
+    for (size_t i = 0; i < keys.size(); i++) {
+        SCOPED_TRACE(keys[i]);
+        ASSERT_EQ(tree.find(keys[i]), found[i]);
+    }
+
+    const tree_t &ctree = tree;
+    std::vector<tree_t::const_iterator> cfound(keys.size());
+    ctree.find_batch(keys, cfound);
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(ctree.find(keys[i]), cfound[i]);
+
+    tree_t empty;
+    empty.find_batch(keys, found);
+    ASSERT_EQ(empty.end(), found[0]);
+}
+
+TEST(find, long_labels_differing_past_the_head)
+{
+    tree_t tree;
+    tree["ab"]        = 1;
+    tree["abcdefgh1"] = 2;
+    tree["abcdefgh2"] = 3;
+
+    // "cdefgh" keeps only "cdef" in the node; these keys differ after it
+    ASSERT_EQ(tree.end(), tree.find("abcdefXX1"));
+    ASSERT_EQ(tree.end(), tree.find("abcdefgX2"));
+    ASSERT_EQ(1, tree.longest_match("abcdefXX1")->second);
+    ASSERT_EQ(2, tree.longest_match("abcdefgh1zz")->second);
+
+    std::vector<std::string> keys = { "abcdefXX1", "abcdefgh2", "abcdefgX", "ab" };
+    std::vector<tree_t::iterator> found(keys.size());
+    tree.longest_match_batch(keys, found);
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(tree.longest_match(keys[i]), found[i]);
+    tree.find_batch(keys, found);
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(tree.find(keys[i]), found[i]);
+
+    ASSERT_TRUE(tree.prefix_range("abcdefX").empty());
+    ASSERT_EQ(2, std::ranges::distance(tree.prefix_range("abcdefg")));
+
+    // splits inside the tail
+    tree["abcdefXX1"] = 4;
+    ASSERT_EQ(4u, tree.size());
+    ASSERT_EQ(4, tree.find("abcdefXX1")->second);
+    ASSERT_EQ(2, tree.find("abcdefgh1")->second);
+    ASSERT_EQ(3, tree.find("abcdefgh2")->second);
+}
+
+TEST(find, deep_chain_of_long_labels)
+{
+    // every level is an 8-byte label without a value, whose first value
+    // node below is at the bottom of the chain
+    std::string chain;
+    for (int i = 0; i < 8 * 1000; i++)
+        chain += static_cast<char>('a' + rand() % 26);
+
+    tree_t tree;
+    for (int i = 1; i <= 1000; i++)
+        tree[chain.substr(0, 8 * i) + "~"] = i;
+
+    for (int i = 1; i <= 1000; i++)
+        ASSERT_EQ(i, tree.find(chain.substr(0, 8 * i) + "~")->second);
+    ASSERT_EQ(1000, tree.longest_match(chain + "~~")->second);
+
+    std::string wrong = chain + "~";
+    wrong[8 * 500 + 6] = '#';
+    ASSERT_EQ(tree.end(), tree.find(wrong));
+    ASSERT_EQ(tree.end(), tree.longest_match(wrong));
+
+    tree[wrong] = -1;
+    ASSERT_EQ(-1, tree.find(wrong)->second);
+    ASSERT_TRUE(tree.erase(wrong));
+    ASSERT_TRUE(tree.erase(chain.substr(0, 8 * 500) + "~"));
+    ASSERT_EQ(1000, tree.find(chain + "~")->second);
+}
@@ -0,0 +1,204 @@
+#include "common.hpp"
+
+#include <radix_tree_image.hpp>
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+static std::string image_path()
+{
+    return testing::TempDir() + "radix_tree_image_" + std::to_string(getpid());
+}
+
+static std::string random_key()
+{
+    static const char letters[] = "abc/";
+    std::string key;
+    int len = rand() % 24;
+    for (int i = 0; i < len; i++)
+        key += letters[rand() % 4];
+    return key;
+}
+
+TEST(image, matches_tree)
+{
+    radix_tree<std::string, int> tree;
+    for (int i = 0; i < 3000; i++)
+        tree.insert_or_assign(random_key(), i);
+
+    std::string path = image_path();
+    ASSERT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    radix_tree_image<int> image;
+    ASSERT_TRUE(image.open(path.c_str()));
+    std::remove(path.c_str());
+
+    ASSERT_EQ(tree.size(), image.size());
+
+    // iteration is in key order, as in the tree
+    radix_tree_image<int>::const_iterator it = image.begin();
+    for (radix_tree<std::string, int>::iterator t = tree.begin(); t != tree.end(); ++t, ++it) {
+        ASSERT_EQ(t->first, it->first);
+        ASSERT_EQ(t->second, it->second);
+    }
+    ASSERT_TRUE(it == image.end());
+
+    for (int i = 0; i < 3000; i++) {
+        std::string key = random_key();
+
+        radix_tree<std::string, int>::iterator t = tree.find(key);
+        it = image.find(key);
+        ASSERT_EQ(t == tree.end(), it == image.end()) << key;
+        if (t != tree.end()) {
+            ASSERT_EQ(t->second, it->second) << key;
+        }
+
+        t  = tree.longest_match(key);
+        it = image.longest_match(key);
+        ASSERT_EQ(t == tree.end(), it == image.end()) << key;
+        if (t != tree.end()) {
+            ASSERT_EQ(t->first, it->first) << key;
+        }
+
+        std::vector<radix_tree<std::string, int>::iterator> expected;
+        std::vector<radix_tree_image<int>::const_iterator> found;
+        tree.prefix_match(key, expected);
+        image.prefix_match(key, found);
+        ASSERT_EQ(expected.size(), found.size()) << key;
+        for (size_t j = 0; j < found.size(); j++)
+            ASSERT_TRUE(found[j]->first.starts_with(key)) << key;
+    }
+}
+
+TEST(image, empty_tree)
+{
+    radix_tree<std::string, int> tree;
+    std::string path = image_path();
+    ASSERT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    radix_tree_image<int> image;
+    ASSERT_TRUE(image.open(path.c_str()));
+    std::remove(path.c_str());
+
+    ASSERT_TRUE(image.empty());
+    ASSERT_TRUE(image.begin() == image.end());
+    ASSERT_TRUE(image.find("") == image.end());
+    ASSERT_TRUE(image.longest_match("abc") == image.end());
+    ASSERT_TRUE(image.prefix_range("").empty());
+}
+
+TEST(image, rejects_bad_files)
+{
+    radix_tree<std::string, int> tree;
+    tree[""] = 1;
+    tree["abc"] = 2;
+
+    std::string path = image_path();
+    ASSERT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    radix_tree_image<int> image;
+    ASSERT_TRUE(image.open(path.c_str()));
+    ASSERT_EQ(2, image.find("abc")->second);
+    image.close();
+
+    // different value type
+    radix_tree_image<long> other;
+    ASSERT_FALSE(other.open(path.c_str()));
+
+    // truncated
+    ASSERT_EQ(0, truncate(path.c_str(), 100));
+    ASSERT_FALSE(image.open(path.c_str()));
+    ASSERT_TRUE(image.empty());
+
+    std::remove(path.c_str());
+    ASSERT_FALSE(image.open(path.c_str()));
+}
+
+// saves tree, lets patch change the file's bytes and opens the result
+template <typename F>
+static bool open_patched(const radix_tree<std::string, int> &tree, F patch)
+{
+    std::string path = image_path();
+    EXPECT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    std::vector<char> bytes(1 << 16);
+    bytes.resize(std::fread(bytes.data(), 1, bytes.size(), file));
+    std::fclose(file);
+
+    radix_tree_image_header *h = reinterpret_cast<radix_tree_image_header*>(bytes.data());
+    patch(h, reinterpret_cast<radix_tree_image_node*>(bytes.data() + h->nodes),
+          reinterpret_cast<std::uint32_t*>(bytes.data() + h->children),
+          reinterpret_cast<radix_tree_image_entry*>(bytes.data() + h->entries));
+
+    file = std::fopen(path.c_str(), "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+
+    radix_tree_image<int> image;
+    bool opened = image.open(path.c_str());
+    if (opened) {
+        // whatever opened has to be safe to walk
+        for (radix_tree_image<int>::const_iterator it = image.begin(); it != image.end(); ++it)
+            image.find(it->first);
+    }
+    std::remove(path.c_str());
+    return opened;
+}
+
+TEST(image, rejects_corrupt_indices)
+{
+    radix_tree<std::string, int> tree;
+    tree["abc"] = 1;
+    tree["abd"] = 2;
+    tree["b"]   = 3;
+
+    typedef radix_tree_image_header header;
+    typedef radix_tree_image_node   node;
+    typedef radix_tree_image_entry  entry;
+
+    ASSERT_TRUE(open_patched(tree, [](header*, node*, std::uint32_t*, entry*) { }));
+
+    // sections that wrap around when their size is added
+    ASSERT_FALSE(open_patched(tree, [](header *h, node*, std::uint32_t*, entry*) { h->child_count = UINT64_MAX / 2; }));
+    ASSERT_FALSE(open_patched(tree, [](header *h, node*, std::uint32_t*, entry*) { h->size = UINT64_MAX / 8; }));
+    // indices out of their sections
+    ASSERT_FALSE(open_patched(tree, [](header*, node*, std::uint32_t *c, entry*) { c[0] = 1000; }));
+    ASSERT_FALSE(open_patched(tree, [](header*, node *n, std::uint32_t*, entry*) { n[0].child_count = 1000; }));
+    ASSERT_FALSE(open_patched(tree, [](header*, node *n, std::uint32_t*, entry*) { n[1].last = 1000; }));
+    ASSERT_FALSE(open_patched(tree, [](header*, node *n, std::uint32_t*, entry*) { n[1].label = UINT64_MAX - 1; }));
+    ASSERT_FALSE(open_patched(tree, [](header*, node*, std::uint32_t*, entry *e) { e[2].key_len = 1000; }));
+    // a child pointing back up would make descents loop
+    ASSERT_FALSE(open_patched(tree, [](header*, node*, std::uint32_t *c, entry*) { c[1] = 0; }));
+}
+
+TEST(image, save_replaces_mapped_image)
+{
+    radix_tree<std::string, int> tree;
+    for (int i = 0; i < 1000; i++)
+        tree[std::to_string(i)] = i;
+
+    std::string path = image_path();
+    ASSERT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    radix_tree_image<int> old_image;
+    ASSERT_TRUE(old_image.open(path.c_str()));
+
+    tree.clear();
+    tree["new"] = -1;
+    ASSERT_TRUE(radix_tree_image<int>::save(tree, path.c_str()));
+
+    // the mapping still sees the whole old file
+    ASSERT_EQ(1000u, old_image.size());
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQ(i, old_image.find(std::to_string(i))->second);
+
+    radix_tree_image<int> new_image;
+    ASSERT_TRUE(new_image.open(path.c_str()));
+    ASSERT_EQ(1u, new_image.size());
+    ASSERT_EQ(-1, new_image.find("new")->second);
+
+    ASSERT_EQ(-1, access((path + ".tmp").c_str(), F_OK));
+    std::remove(path.c_str());
+}
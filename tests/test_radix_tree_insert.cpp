@@ -1,5 +1,7 @@
 #include "common.hpp"
 
+#include <memory>
+
 TEST(insert, change_size)
 {
     std::vector<std::string> unique_keys = get_unique_keys();
@@ -118,3 +120,400 @@ TEST(insert, after_erase)
         ASSERT_TRUE(r.second);
     }
 }
+
+TEST(insert, key_ending_at_branch)
+{
+    tree_t tree;
+    tree["abc"] = 1;
+    tree["abd"] = 2;
+    // "ab" ends at the node splitting "abc" and "abd"
+    std::pair<tree_t::iterator, bool> r = tree.insert( tree_t::value_type("ab", 3) );
+    ASSERT_TRUE(r.second);
+    ASSERT_EQ("ab", r.first->first);
+    ASSERT_EQ(3, r.first->second);
+    ASSERT_EQ(3, tree.find("ab")->second);
+    ASSERT_EQ(1, tree.find("abc")->second);
+    ASSERT_EQ(2, tree.find("abd")->second);
+
+    std::vector<std::string> keys;
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it)
+        keys.push_back(it->first);
+    const std::string expected[] = { "ab", "abc", "abd" };
+    ASSERT_EQ(make_vector(expected), keys);
+}
+
+namespace {
+    struct counted {
+        static int constructed;
+        int value;
+        explicit counted(int v = 0) : value(v) { constructed++; }
+    };
+    int counted::constructed = 0;
+}
+
+TEST(insert, try_emplace)
+{
+    radix_tree<std::string, counted> tree;
+    counted::constructed = 0;
+
+    std::pair<radix_tree<std::string, counted>::iterator, bool> r = tree.try_emplace("abc", 1);
+    ASSERT_TRUE(r.second);
+    ASSERT_EQ(1, r.first->second.value);
+    ASSERT_EQ(1, counted::constructed);
+
+    // an existing key leaves the arguments unused
+    r = tree.try_emplace("abc", 2);
+    ASSERT_FALSE(r.second);
+    ASSERT_EQ(1, r.first->second.value);
+    ASSERT_EQ(1, counted::constructed);
+
+    // split an edge and stop at the split point
+    ASSERT_TRUE(tree.try_emplace("abd", 3).second);
+    ASSERT_TRUE(tree.try_emplace("ab", 4).second);
+    ASSERT_EQ(3, counted::constructed);
+    ASSERT_EQ(4, tree.find("ab")->second.value);
+    ASSERT_EQ(3u, tree.size());
+}
+
+TEST(insert, move_only_value)
+{
+    radix_tree<std::string, std::unique_ptr<int> > tree;
+    std::string key = "movable";
+
+    ASSERT_TRUE(tree.try_emplace(std::move(key), new int(1)).second);
+    ASSERT_TRUE(tree.emplace("key", std::unique_ptr<int>(new int(2))).second);
+    ASSERT_TRUE(tree.insert(std::make_pair(std::string("kez"), std::unique_ptr<int>(new int(3)))).second);
+    ASSERT_EQ(1, *tree.find("movable")->second);
+    ASSERT_EQ(2, *tree.find("key")->second);
+    ASSERT_EQ(3, *tree.find("kez")->second);
+    ASSERT_EQ(3u, tree.size());
+}
+
+TEST(insert, insert_or_assign)
+{
+    tree_t tree;
+    std::pair<tree_t::iterator, bool> r = tree.insert_or_assign("abc", 1);
+    ASSERT_TRUE(r.second);
+    ASSERT_EQ(1, r.first->second);
+
+    r = tree.insert_or_assign("abc", 2);
+    ASSERT_FALSE(r.second);
+    ASSERT_EQ(2, r.first->second);
+    ASSERT_EQ(2, tree.find("abc")->second);
+    ASSERT_EQ(1u, tree.size());
+}
+
+TEST(insert, subscript_counts)
+{
+    tree_t tree;
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < unique_keys.size(); i++)
+            tree[unique_keys[i]]++;
+    }
+    ASSERT_EQ(unique_keys.size(), tree.size());
+    for (size_t i = 0; i < unique_keys.size(); i++)
+        ASSERT_EQ(3, tree.find(unique_keys[i])->second);
+}
+
+TEST(insert, mismatch_kernel)
+{
+    std::string a(300, 'x');
+    for (int len = 0; len <= 300; len++) {
+        ASSERT_EQ(len, radix_mismatch_bytes(a.data(), a.data(), len));
+        for (int pos = 0; pos < len; pos += 1 + pos / 16) {
+            std::string b = a;
+            b[pos] = 'y';
+            ASSERT_EQ(pos, radix_mismatch_bytes(a.data(), b.data(), len)) << len;
+            ASSERT_EQ(pos, radix_mismatch(std::string_view(b), 0, a, len)) << len;
+        }
+    }
+}
+
+TEST(insert, split_long_labels)
+{
+    // every key splits a long edge at a different depth
+    tree_t tree;
+    std::string base(250, 'k');
+    std::vector<std::string> keys;
+    for (int i = 0; i < 250; i += 7) {
+        std::string key = base;
+        key[i] = 'z';
+        keys.push_back(key);
+        keys.push_back(key.substr(0, i + 1));
+    }
+    keys.push_back(base);
+
+    for (size_t i = 0; i < keys.size(); i++)
+        tree[keys[i]] = static_cast<int>(i);
+    ASSERT_EQ(keys.size(), tree.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(static_cast<int>(i), tree.find(keys[i])->second);
+    ASSERT_EQ(tree.end(), tree.find(base.substr(0, 249)));
+}
+
+static void expect_same_entries(tree_t &tree, const std::map<std::string, int> &expected)
+{
+    ASSERT_EQ(expected.size(), tree.size());
+
+    std::map<std::string, int>::const_iterator e = expected.begin();
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++e) {
+        ASSERT_EQ(e->first, it->first);
+        ASSERT_EQ(e->second, it->second);
+    }
+    for (e = expected.begin(); e != expected.end(); ++e) {
+        ASSERT_EQ(e->second, tree.find(e->first)->second) << e->first;
+        ASSERT_EQ(tree.end(), tree.find(e->first + "\x01"));
+    }
+}
+
+static std::map<std::string, int> random_entries(int count)
+{
+    std::map<std::string, int> entries;
+    for (int i = 0; i < count; i++) {
+        std::string key;
+        int len = rand() % 12;
+        for (int j = 0; j < len; j++)
+            key += "abc\xff"[rand() % 4];
+        entries[key] = i;
+    }
+    return entries;
+}
+
+template <typename Compare>
+void split_failing_allocation()
+{
+    typedef radix_tree<std::string, int, Compare, failing_allocator<std::pair<const std::string, int> > > failing_tree_t;
+
+    for (long n = 0; n < 3; n++) {
+        failing_tree_t tree;
+        tree["abcdef"] = 1;
+        tree["abcdefgh"] = 2;
+        tree["x"] = 3;
+
+        // the split needs a node, its child table and the leaf
+        allocations_left = n;
+        ASSERT_THROW(tree["abcxyz"] = 4, std::bad_alloc);
+        allocations_left = -1;
+
+        ASSERT_EQ(3u, tree.size());
+        ASSERT_EQ(1, tree.find("abcdef")->second);
+        ASSERT_EQ(2, tree.find("abcdefgh")->second);
+        ASSERT_EQ(3, tree.find("x")->second);
+        ASSERT_EQ(tree.end(), tree.find("abcxyz"));
+
+        tree["abcxyz"] = 4;
+        ASSERT_EQ(4u, tree.size());
+        ASSERT_EQ(1, tree.find("abcdef")->second);
+        ASSERT_EQ(4, tree.find("abcxyz")->second);
+    }
+}
+
+TEST(insert, split_failing_allocation)
+{
+    split_failing_allocation<std::less<std::string> >();
+    split_failing_allocation<std::greater<std::string> >();
+}
+
+// a key whose copies allocate through failing_allocator; std::greater keeps
+// its labels in the map layout, which holds copies of them
+typedef std::basic_string<char, std::char_traits<char>, failing_allocator<char> > failing_string;
+typedef radix_tree<failing_string, int, std::greater<failing_string> > failing_key_tree_t;
+
+template<>
+failing_string radix_substr<failing_string>(const failing_string &key, int begin, int num)
+{
+    return key.substr(begin, num);
+}
+
+template<>
+failing_string radix_join<failing_string>(const failing_string &key1, const failing_string &key2)
+{
+    return key1 + key2;
+}
+
+template<>
+int radix_length<failing_string>(const failing_string &key)
+{
+    return static_cast<int>(key.size());
+}
+
+typedef std::map<failing_string, int, std::greater<failing_string> > failing_map_t;
+
+// runs change on a copy of base with the n-th allocation failing, for every
+// n until change goes through, and then has expect apply it to the map. A
+// failed change must leave the entries and their order as they were.
+template <typename F, typename G>
+static void fail_each_allocation(const failing_map_t &base, F change, G expect)
+{
+    for (long n = 0; ; n++) {
+        failing_key_tree_t tree;
+        for (failing_map_t::const_iterator it = base.begin(); it != base.end(); ++it)
+            tree[it->first] = it->second;
+
+        failing_map_t expected(base);
+        bool done = false;
+        allocations_left = n;
+        try {
+            change(tree);
+            done = true;
+        } catch (const std::bad_alloc&) {
+        }
+        allocations_left = -1;
+        if (done)
+            expect(expected);
+
+        ASSERT_EQ(expected.size(), tree.size()) << n;
+        failing_key_tree_t::iterator it = tree.begin();
+        for (failing_map_t::iterator e = expected.begin(); e != expected.end(); ++e, ++it) {
+            ASSERT_NE(tree.end(), it) << n;
+            ASSERT_EQ(e->first, it->first) << n;
+            ASSERT_EQ(e->second, it->second) << n;
+            ASSERT_EQ(it, tree.find(e->first)) << n;
+        }
+        ASSERT_EQ(tree.end(), it) << n;
+
+        // the tree is still whole: it takes every change after a failure
+        for (failing_map_t::iterator e = expected.begin(); e != expected.end(); ++e)
+            ASSERT_TRUE(tree.erase(e->first)) << n;
+        ASSERT_TRUE(tree.empty()) << n;
+
+        if (done)
+            return;
+    }
+}
+
+TEST(insert, failing_label_copies)
+{
+    // every label here is too long to be kept inside the string object
+    const failing_string stem("a label long enough to live on the heap/");
+    const failing_string mid = stem + "and a second label that is just as long/";
+    const failing_string first   = mid + "the first entry under both labels";
+    const failing_string sibling = stem + "a sibling entry with a label of its own";
+
+    failing_map_t base;
+    base[first] = 1;
+    base[mid + "the second entry under both labels"] = 2;
+    base[mid] = 3;
+    base[sibling] = 4;
+
+    const failing_string split_stem = "a label long enough to live on the heap, split";
+    const failing_string split_mid  = stem + "and a second label that is just as long, split";
+
+    {
+        SCOPED_TRACE("split of the first label");
+        fail_each_allocation(base, [&](failing_key_tree_t &tree) { tree[split_stem] = 5; },
+                             [&](failing_map_t &expected) { expected[split_stem] = 5; });
+    }
+    {
+        SCOPED_TRACE("split of the second label");
+        fail_each_allocation(base, [&](failing_key_tree_t &tree) { tree[split_mid] = 6; },
+                             [&](failing_map_t &expected) { expected[split_mid] = 6; });
+    }
+    {
+        SCOPED_TRACE("store in a branching node");
+        failing_map_t without(base);
+        without.erase(mid);
+        fail_each_allocation(without, [&](failing_key_tree_t &tree) { tree[mid] = 7; },
+                             [&](failing_map_t &expected) { expected[mid] = 7; });
+    }
+    {
+        SCOPED_TRACE("erase merging the node into its child");
+        failing_map_t single(base);
+        single.erase(mid + "the second entry under both labels");
+        fail_each_allocation(single, [&](failing_key_tree_t &tree) { tree.erase(mid); },
+                             [&](failing_map_t &expected) { expected.erase(mid); });
+    }
+    {
+        SCOPED_TRACE("erase merging the parent into the sibling");
+        failing_map_t pair(base);
+        pair.erase(mid);
+        fail_each_allocation(pair, [&](failing_key_tree_t &tree) { tree.erase(first); },
+                             [&](failing_map_t &expected) { expected.erase(first); });
+    }
+    {
+        SCOPED_TRACE("extract_prefix");
+        fail_each_allocation(base, [&](failing_key_tree_t &tree) {
+                                 failing_key_tree_t part = tree.extract_prefix(mid);
+                                 ASSERT_EQ(3u, part.size());
+                             },
+                             [&](failing_map_t &expected) {
+                                 for (failing_map_t::iterator it = expected.begin(); it != expected.end(); )
+                                     it = it->first.compare(0, mid.size(), mid) == 0 ? expected.erase(it) : std::next(it);
+                             });
+    }
+}
+
+TEST(insert, bulk_load_sorted)
+{
+    std::vector<std::string> unique_keys = get_unique_keys();
+    std::sort(unique_keys.begin(), unique_keys.end());
+
+    std::vector<tree_t::value_type> entries;
+    std::map<std::string, int> expected;
+    entries.push_back(tree_t::value_type("", -1));
+    expected[""] = -1;
+    for (size_t i = 0; i < unique_keys.size(); i++) {
+        entries.push_back(tree_t::value_type(unique_keys[i], static_cast<int>(i)));
+        expected[unique_keys[i]] = static_cast<int>(i);
+    }
+
+    tree_t tree(entries.begin(), entries.end());
+    expect_same_entries(tree, expected);
+
+    std::map<std::string, int> random = random_entries(3000);
+    tree_t large(random.begin(), random.end());
+    expect_same_entries(large, random);
+}
+
+TEST(insert, bulk_load_unsorted_and_duplicates)
+{
+    std::map<std::string, int> expected = random_entries(2000);
+    std::vector<std::pair<std::string, int> > entries(expected.begin(), expected.end());
+    std::random_shuffle(entries.begin(), entries.end());
+    // a duplicate does not replace the first value, as with insert()
+    entries.push_back(std::make_pair(entries.front().first, -5));
+
+    tree_t tree;
+    tree.insert(*expected.begin());
+    ASSERT_EQ(expected.size() - 1, tree.bulk_load(entries.begin(), entries.end()));
+    expect_same_entries(tree, expected);
+
+    // a second sorted run interleaves with what is there
+    std::map<std::string, int> more = random_entries(2000);
+    tree.bulk_load(more.begin(), more.end());
+    more.insert(expected.begin(), expected.end());
+    for (std::map<std::string, int>::iterator it = more.begin(); it != more.end(); ++it)
+        it->second = expected.count(it->first) ? expected[it->first] : it->second;
+    expect_same_entries(tree, more);
+}
+
+TEST(insert, bulk_load_parallel)
+{
+    std::map<std::string, int> expected = random_entries(5000);
+    std::vector<std::pair<std::string, int> > entries(expected.begin(), expected.end());
+
+    for (unsigned threads = 2; threads <= 9; threads += 7) {
+        tree_t tree(entries.begin(), entries.end(), threads);
+        expect_same_entries(tree, expected);
+    }
+
+    // unsorted parts overlap in the root's child slots
+    std::random_shuffle(entries.begin(), entries.end());
+    tree_t tree;
+    ASSERT_EQ(expected.size(), tree.bulk_load(entries.begin(), entries.end(), 4));
+    expect_same_entries(tree, expected);
+}
+
+TEST(insert, bulk_load_arena)
+{
+    radix_tree_arena arena;
+    typedef radix_tree<std::string, int, std::less<std::string>, radix_tree_arena_allocator<std::pair<const std::string, int> > > arena_tree_t;
+
+    std::map<std::string, int> expected = random_entries(1000);
+    arena_tree_t tree(arena);
+    // a stateful allocator keeps the load on one thread
+    ASSERT_EQ(expected.size(), tree.bulk_load(expected.begin(), expected.end(), 4));
+    for (std::map<std::string, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+        ASSERT_EQ(it->second, tree.find(it->first)->second);
+}
@@ -108,3 +108,132 @@ TEST(iterator, std__copy)
         ASSERT_NE(map.end(), map.find(it->first));
     }
 }
+
+template <typename Tree>
+static void check_reverse_walk(Tree &tree)
+{
+    std::vector<std::string> forward;
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+        forward.push_back(it->first);
+
+    std::vector<std::string> backward;
+    for (typename Tree::iterator it = tree.end(); it != tree.begin(); ) {
+        --it;
+        backward.push_back(it->first);
+    }
+    std::reverse(backward.begin(), backward.end());
+    ASSERT_EQ(forward, backward);
+}
+
+TEST(iterator, decrement)
+{
+    tree_t tree;
+    ASSERT_TRUE(tree.begin() == tree.end());
+
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (size_t i = 0; i < unique_keys.size(); i++)
+        tree[unique_keys[i]] = static_cast<int>(i);
+    tree[""] = -1;
+    {
+        SCOPED_TRACE("byte keys");
+        check_reverse_walk(tree);
+    }
+
+    // wide nodes step back through their byte tables
+    for (int i = 0; i < 256; i++)
+        tree[std::string("w") + static_cast<char>(i)] = i;
+    {
+        SCOPED_TRACE("wide nodes");
+        check_reverse_walk(tree);
+    }
+
+    tree_t::iterator it = tree.find("ab");
+    tree_t::iterator copy = it--;
+    ASSERT_EQ("ab", copy->first);
+    ASSERT_EQ("aab", it->first);
+    ASSERT_EQ("ab", (++it)->first);
+}
+
+TEST(iterator, decrement_custom_compare)
+{
+    radix_tree<std::string, int, greater_string> tree;
+    std::map<std::string, int, greater_string> map;
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (size_t i = 0; i < unique_keys.size(); i++) {
+        tree[unique_keys[i]] = static_cast<int>(i);
+        map[unique_keys[i]] = static_cast<int>(i);
+    }
+    tree[""] = -1;
+    map[""] = -1;
+
+    // stepping back from end() visits the entries in reverse Compare order
+    std::map<std::string, int, greater_string>::reverse_iterator expected = map.rbegin();
+    for (radix_tree<std::string, int, greater_string>::iterator it = tree.end(); it != tree.begin(); ++expected) {
+        --it;
+        ASSERT_NE(map.rend(), expected);
+        ASSERT_EQ(expected->first, it->first);
+    }
+    ASSERT_EQ(map.rend(), expected);
+
+    check_reverse_walk(tree);
+}
+
+TEST(iterator, custom_compare_order)
+{
+    const char *keys[] = { "a", "ab", "b", "abc", "ba", "", "abcd", "abd", "bab", "c" };
+    radix_tree<std::string, int, greater_string> tree;
+    std::map<std::string, int, greater_string> map;
+
+    for (int i = 0; i < 10; i++) {
+        tree[keys[i]] = i;
+        map[keys[i]] = i;
+
+        std::vector<std::string> expected, found;
+        for (std::map<std::string, int, greater_string>::iterator it = map.begin(); it != map.end(); ++it)
+            expected.push_back(it->first);
+        for (radix_tree<std::string, int, greater_string>::iterator it = tree.begin(); it != tree.end(); ++it)
+            found.push_back(it->first);
+        ASSERT_EQ(expected, found) << "after " << keys[i];
+    }
+
+    check_reverse_walk(tree);
+
+    // prefix matches come in the same order
+    std::vector<radix_tree<std::string, int, greater_string>::iterator> vec;
+    tree.prefix_match("ab", vec);
+    std::vector<std::string> found;
+    for (size_t i = 0; i < vec.size(); i++)
+        found.push_back(vec[i]->first);
+    ASSERT_EQ(std::vector<std::string>({ "abd", "abcd", "abc", "ab" }), found);
+}
+
+TEST(iterator, const_tree)
+{
+    tree_t tree;
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (size_t i = 0; i < unique_keys.size(); i++)
+        tree[unique_keys[i]] = static_cast<int>(i);
+
+    const tree_t &ctree = tree;
+    static_assert(std::is_same<decltype(*ctree.begin()), const tree_t::value_type&>::value, "const tree yields const entries");
+    static_assert(std::is_same<decltype(ctree.find("a")), tree_t::const_iterator>::value, "const find");
+
+    tree_t::const_iterator cit = tree.begin(); // iterator converts to const_iterator
+    ASSERT_TRUE(cit == tree.begin());
+    ASSERT_TRUE(tree.begin() == cit);
+    ASSERT_EQ(size_t(std::distance(tree.cbegin(), tree.cend())), tree.size());
+
+    for (size_t i = 0; i < unique_keys.size(); i++) {
+        tree_t::const_iterator it = ctree.find(unique_keys[i]);
+        ASSERT_TRUE(it != ctree.end());
+        ASSERT_EQ(static_cast<int>(i), it->second);
+        ASSERT_EQ(unique_keys[i], ctree.longest_match(unique_keys[i] + "zz")->first);
+    }
+    ASSERT_TRUE(ctree.find("zz") == ctree.cend());
+
+    std::vector<tree_t::const_iterator> vec;
+    ctree.prefix_match("ab", vec);
+    ASSERT_EQ(3u, vec.size()); // ab aba abb
+    ctree.greedy_match("ba", vec);
+    ASSERT_FALSE(vec.empty());
+}
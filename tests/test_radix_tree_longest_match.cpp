@@ -69,3 +69,23 @@ TEST(longest_match, complex_tree)
         }
     }
 }
+
+TEST(longest_match, batch_matches_single_lookups)
+{
+    tree_t tree;
+    tree["abcdef"] = 1;
+    tree["abcdege"] = 2;
+    tree["bcdef"] = 3;
+    tree["cd"] = 4;
+    tree["ce"] = 5;
+    tree["c"] = 6;
+
+    const char *keys[] = { "abcdefg", "abcdegeh", "abcd", "bcdefxy", "bcde", "cde", "cex", "c", "x", "", "abcdeg" };
+    std::vector<tree_t::iterator> found(sizeof(keys) / sizeof(keys[0]));
+
+    tree.longest_match_batch(keys, found);
+    for (size_t i = 0; i < found.size(); i++) {
+        SCOPED_TRACE(keys[i]);
+        ASSERT_EQ(tree.longest_match(keys[i]), found[i]);
+    }
+}
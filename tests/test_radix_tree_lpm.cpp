@@ -0,0 +1,145 @@
+#include "common.hpp"
+
+#include <radix_tree_lpm.hpp>
+
+// random routes, nested under a few common /8s and around /24
+static void random_route(std::uint32_t &addr, int &len)
+{
+    static const int lengths[] = { 0, 8, 12, 16, 19, 22, 24, 24, 24, 25, 28, 30, 32 };
+
+    len  = lengths[rand() % (sizeof(lengths) / sizeof(lengths[0]))];
+    addr = (std::uint32_t(10 + rand() % 2) << 24) | ((std::uint32_t(rand()) & 0x3) << 16) | (std::uint32_t(rand()) & 0xffff);
+    addr &= radix_bits<std::uint32_t>::mask(len);
+}
+
+template <typename Table>
+static void check_against_patricia(Table &table, const ipv4_radix_tree<int> &rules, int lookups)
+{
+    for (int i = 0; i < lookups; i++) {
+        std::uint32_t addr;
+        int           len;
+        random_route(addr, len);
+        addr |= std::uint32_t(rand()) & ~radix_bits<std::uint32_t>::mask(len);
+        if (i % 8 == 0)
+            addr = (std::uint32_t(rand()) << 16) ^ std::uint32_t(rand());
+
+        const int *expected = rules.longest_match(addr);
+        const int *value    = table.longest_match(addr);
+        ASSERT_EQ(expected != NULL, value != NULL) << std::hex << addr;
+        if (value != NULL) {
+            ASSERT_EQ(*expected, *value) << std::hex << addr;
+        }
+    }
+}
+
+template <typename Table>
+static void check_incremental(Table &table)
+{
+    ipv4_radix_tree<int> rules;
+
+    for (int i = 0; i < 1000; i++) {
+        std::uint32_t addr;
+        int           len;
+        random_route(addr, len);
+        if (rules.insert(addr, len, i).second)
+            table.add(addr, len, i);
+    }
+    table.rebuild();
+    ASSERT_EQ(rules.size(), table.size());
+    check_against_patricia(table, rules, 20000);
+
+    for (int i = 0; i < 300; i++) {
+        std::uint32_t addr;
+        int           len;
+        random_route(addr, len);
+
+        if (rand() % 2) {
+            bool erased = rules.erase(addr, len);
+            ASSERT_EQ(erased, table.erase(addr, len));
+        } else {
+            if (int *value = rules.find(addr, len))
+                *value = 1000 + i;
+            else
+                rules.insert(addr, len, 1000 + i);
+            table.insert(addr, len, 1000 + i);
+        }
+
+        if (i % 50 == 0)
+            check_against_patricia(table, rules, 2000);
+    }
+    ASSERT_EQ(rules.size(), table.size());
+    check_against_patricia(table, rules, 20000);
+}
+
+TEST(lpm, dir24_8_incremental)
+{
+    dir24_8_lpm<int> table;
+    check_incremental(table);
+}
+
+TEST(lpm, dir24_8_routes)
+{
+    dir24_8_lpm<std::string> table;
+    table.insert(0x0a010203, 32, "10.1.2.3/32");
+    table.insert(0x0a010200, 23, "10.1.2/23");
+    table.insert(0x0a000000, 8, "10/8");
+    table.insert(0, 0, "default");
+
+    // a shorter route added later does not cover the longer ones
+    ASSERT_EQ("10.1.2.3/32", *table.longest_match(0x0a010203));
+    ASSERT_EQ("10.1.2/23", *table.longest_match(0x0a010204));
+    ASSERT_EQ("10.1.2/23", *table.longest_match(0x0a010304));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a020304));
+    ASSERT_EQ("default", *table.longest_match(0xc0a80001));
+
+    // erased routes hand their addresses to the covering one
+    ASSERT_TRUE(table.erase(0x0a010200, 23));
+    ASSERT_EQ("10.1.2.3/32", *table.longest_match(0x0a010203));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a010204));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a010304));
+
+    ASSERT_TRUE(table.erase(0x0a010203, 32));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a010203));
+
+    ASSERT_TRUE(table.erase(0, 0));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a010203));
+    ASSERT_EQ(NULL, table.longest_match(0xc0a80001));
+
+    ASSERT_TRUE(table.erase(0x0a000000, 8));
+    ASSERT_EQ(NULL, table.longest_match(0x0a010203));
+    ASSERT_TRUE(table.empty());
+}
+
+TEST(lpm, poptrie_incremental)
+{
+    poptrie_lpm<int> table;
+    check_incremental(table);
+}
+
+TEST(lpm, poptrie_routes)
+{
+    poptrie_lpm<std::string> table;
+    table.insert(0, 0, "default");
+    table.insert(0x0a000000, 8, "10/8");
+    table.insert(0x0a010000, 16, "10.1/16");
+    table.insert(0x0a010200, 23, "10.1.2/23");
+    table.insert(0x0a010203, 32, "10.1.2.3/32");
+
+    ASSERT_EQ("10.1.2.3/32", *table.longest_match(0x0a010203));
+    ASSERT_EQ("10.1.2/23", *table.longest_match(0x0a010304));
+    ASSERT_EQ("10.1/16", *table.longest_match(0x0a010404));
+    ASSERT_EQ("10/8", *table.longest_match(0x0a020304));
+    ASSERT_EQ("default", *table.longest_match(0xc0a80001));
+    ASSERT_EQ("10.1/16", *table.find(0x0a01ffff, 16));
+
+    ASSERT_TRUE(table.erase(0x0a010203, 32));
+    ASSERT_FALSE(table.erase(0x0a010203, 32));
+    ASSERT_EQ("10.1.2/23", *table.longest_match(0x0a010203));
+    ASSERT_TRUE(table.erase(0, 0));
+    ASSERT_TRUE(table.longest_match(0xc0a80001) == NULL);
+
+    table.clear();
+    ASSERT_TRUE(table.empty());
+    ASSERT_TRUE(table.longest_match(0x0a010203) == NULL);
+    ASSERT_EQ(0u, table.node_count());
+}
@@ -0,0 +1,98 @@
+#include "common.hpp"
+
+#include <atomic>
+#include <mutex>
+
+static std::map<std::string, int> random_entries(int count)
+{
+    std::map<std::string, int> entries;
+    for (int i = 0; i < count; i++) {
+        std::string key;
+        int len = rand() % 10;
+        for (int j = 0; j < len; j++)
+            key += "abcdefgh"[rand() % 8];
+        entries[key] = i;
+    }
+    return entries;
+}
+
+TEST(parallel, build_from_unsorted)
+{
+    std::map<std::string, int> expected = random_entries(5000);
+    std::vector<std::pair<std::string, int> > entries(expected.begin(), expected.end());
+    std::random_shuffle(entries.begin(), entries.end());
+    // of duplicates the first one wins, as with insert()
+    entries.push_back(std::make_pair(entries[entries.size() / 2].first, -1));
+
+    for (unsigned threads = 1; threads <= 16; threads *= 4) {
+        tree_t tree(entries.begin(), entries.end(), threads);
+
+        ASSERT_EQ(expected.size(), tree.size());
+        std::map<std::string, int>::iterator e = expected.begin();
+        for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++e) {
+            ASSERT_EQ(e->first, it->first);
+            ASSERT_EQ(e->second, it->second);
+        }
+    }
+}
+
+TEST(parallel, for_each)
+{
+    std::map<std::string, int> expected = random_entries(5000);
+    tree_t tree(expected.begin(), expected.end());
+
+    for (unsigned threads = 1; threads <= 16; threads *= 4) {
+        std::mutex lock;
+        std::map<std::string, int> seen;
+        tree.parallel_for_each([&](tree_t::value_type &val) {
+            val.second++;
+            std::lock_guard<std::mutex> hold(lock);
+            ASSERT_TRUE(seen.insert(val).second) << val.first;
+        }, threads);
+        ASSERT_EQ(expected.size(), seen.size());
+    }
+    for (std::map<std::string, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+        ASSERT_EQ(it->second + 3, tree.find(it->first)->second);
+
+    std::atomic<int> count(0);
+    tree.parallel_for_each("ab", [&](tree_t::value_type &val) {
+        ASSERT_EQ(0u, val.first.find("ab"));
+        count++;
+    }, 4);
+    std::vector<tree_t::iterator> vec;
+    tree.prefix_match("ab", vec);
+    ASSERT_EQ(vec.size(), static_cast<size_t>(count.load()));
+
+    tree.parallel_for_each("zz", [&](tree_t::value_type&) { FAIL(); }, 4);
+
+    tree_t empty;
+    empty.parallel_for_each([&](tree_t::value_type&) { FAIL(); }, 4);
+}
+
+TEST(parallel, remove_if)
+{
+    std::map<std::string, int> expected = random_entries(5000);
+    tree_t tree(expected.begin(), expected.end());
+
+    auto doomed = [](const std::string &key) { return key.size() % 3 == 1 || key.find("cd") != std::string::npos; };
+
+    size_t erased = 0;
+    for (std::map<std::string, int>::iterator it = expected.begin(); it != expected.end(); ) {
+        if (doomed(it->first)) {
+            it = expected.erase(it);
+            erased++;
+        } else {
+            ++it;
+        }
+    }
+
+    ASSERT_EQ(erased, tree.parallel_remove_if(doomed, 8));
+    ASSERT_EQ(expected.size(), tree.size());
+    std::map<std::string, int>::iterator e = expected.begin();
+    for (tree_t::iterator it = tree.begin(); it != tree.end(); ++it, ++e)
+        ASSERT_EQ(e->first, it->first);
+
+    ASSERT_EQ(expected.size(), tree.parallel_remove_if([](const std::string&) { return true; }, 8));
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.end(), tree.begin());
+}
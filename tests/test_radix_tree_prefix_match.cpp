@@ -94,3 +94,52 @@ TEST(prefix_match, complex_tree)
     }
     check_nonexistent_prefixes(tree);
 }
+
+TEST(prefix_match, range_matches_vector)
+{
+    tree_t tree;
+    std::vector<std::string> unique_keys = get_unique_keys();
+    for (size_t i = 0; i < unique_keys.size(); i++)
+        tree[unique_keys[i]] = static_cast<int>(i);
+
+    const char *prefixes[] = { "", "a", "ab", "abb", "b", "bab", "c", "abx" };
+    for (size_t p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); p++) {
+        SCOPED_TRACE(prefixes[p]);
+        vector_found_t vec;
+        tree.prefix_match(prefixes[p], vec);
+
+        vector_found_t lazy;
+        tree_t::range range = tree.prefix_range(prefixes[p]);
+        for (tree_t::iterator it = range.begin(); it != range.end(); ++it)
+            lazy.push_back(it);
+        ASSERT_EQ(vec_found_to_map(vec), vec_found_to_map(lazy));
+
+        tree_t::const_range crange = static_cast<const tree_t&>(tree).prefix_range(prefixes[p]);
+        ASSERT_EQ(vec.size(), size_t(std::ranges::distance(crange)));
+    }
+}
+
+TEST(prefix_match, visit_stops_early)
+{
+    tree_t tree;
+    for (int i = 0; i < 1000; i++)
+        tree["key" + std::to_string(i)] = i;
+
+    std::vector<std::string> top;
+    bool finished = tree.prefix_visit("key1", [&](const tree_t::value_type &entry) {
+        top.push_back(entry.first);
+        return top.size() < 3;
+    });
+    ASSERT_FALSE(finished);
+    const std::string expected[] = { "key1", "key10", "key100" };
+    ASSERT_EQ(make_vector(expected), top);
+
+    int count = 0;
+    ASSERT_TRUE(tree.prefix_visit("key99", [&](const tree_t::value_type &) { count++; return true; }));
+    ASSERT_EQ(11, count);
+
+    tree.erase("key1");
+    for (int i = 0; i < 1000; i++)
+        tree.erase("key" + std::to_string(i));
+    ASSERT_TRUE(tree.prefix_range("").empty());
+}
@@ -0,0 +1,101 @@
+#include "common.hpp"
+
+#include <numeric>
+
+template <typename Tree>
+void check_consistent(const Tree &tree)
+{
+    radix_tree_stats stats = tree.stats();
+
+    ASSERT_EQ(tree.size(), stats.entries);
+    ASSERT_EQ(stats.nodes, stats.internal_nodes + stats.leaf_nodes);
+    ASSERT_EQ(stats.nodes, std::accumulate(stats.fanout.begin(), stats.fanout.end(), std::size_t(0)));
+    ASSERT_EQ(stats.nodes, std::accumulate(stats.depth.begin(), stats.depth.end(), std::size_t(0)));
+    ASSERT_EQ(stats.leaf_nodes, stats.fanout.empty() ? 0 : stats.fanout[0]);
+
+    // every node but the root hangs off one child table slot
+    std::size_t children = 0;
+    for (std::size_t n = 0; n < stats.fanout.size(); n++)
+        children += n * stats.fanout[n];
+    ASSERT_EQ(stats.nodes == 0 ? 0 : stats.nodes - 1, children);
+
+    ASSERT_GE(stats.value_nodes, stats.entries);
+    ASSERT_LE(stats.value_nodes, stats.nodes);
+    ASSERT_EQ(stats.node_bytes + stats.table_bytes + stats.key_bytes, stats.allocated_bytes());
+}
+
+TEST(stats, empty)
+{
+    tree_t tree;
+    radix_tree_stats stats = tree.stats();
+
+    ASSERT_EQ(0u, stats.entries);
+    ASSERT_EQ(0u, stats.nodes);
+    ASSERT_EQ(0u, stats.allocated_bytes());
+    ASSERT_EQ(0.0, stats.bytes_per_key());
+}
+
+TEST(stats, shape)
+{
+    tree_t tree;
+    tree["abc"]  = 1;
+    tree["abd"]  = 2;
+    tree["abde"] = 3;
+    tree["x"]    = 4;
+
+    // root -> "ab" -> { "c", "d" -> "e" }, root -> "x"
+    radix_tree_stats stats = tree.stats();
+    ASSERT_EQ(4u, stats.entries);
+    ASSERT_EQ(6u, stats.nodes);
+    ASSERT_EQ(3u, stats.internal_nodes);
+    ASSERT_EQ(3u, stats.leaf_nodes);
+    ASSERT_EQ(4u, stats.value_nodes);
+    ASSERT_EQ((std::vector<std::size_t>{ 3, 1, 2 }), stats.fanout);
+    ASSERT_EQ((std::vector<std::size_t>{ 1, 2, 2, 1 }), stats.depth);
+    ASSERT_EQ(6u, stats.label_bytes);
+    ASSERT_EQ(3u, stats.layouts[0]);
+    ASSERT_GT(stats.table_bytes, 0u);
+    ASSERT_DOUBLE_EQ(stats.allocated_bytes() / 4.0, stats.bytes_per_key());
+    check_consistent(tree);
+}
+
+TEST(stats, follows_inserts_and_erases)
+{
+    tree_t tree;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2000; i++)
+        keys.push_back("http://host" + std::to_string(i % 37) + "/path/" + std::to_string(i * 7919));
+
+    for (const std::string &key : keys) {
+        tree[key] = 1;
+        check_consistent(tree);
+    }
+    radix_tree_stats full = tree.stats();
+    ASSERT_GT(full.layouts[1] + full.layouts[2], 0u);
+
+    for (std::size_t i = 0; i < keys.size(); i += 2) {
+        tree.erase(keys[i]);
+        check_consistent(tree);
+    }
+    radix_tree_stats half = tree.stats();
+    ASSERT_LT(half.nodes, full.nodes);
+    ASSERT_LT(half.allocated_bytes(), full.allocated_bytes());
+
+    tree.clear();
+    ASSERT_EQ(0u, tree.stats().nodes);
+}
+
+TEST(stats, map_layout)
+{
+    radix_tree<std::string, int, greater_string> tree;
+    tree["a rather long key that does not fit in place"] = 1;
+    tree["a rather long key that does not fit here"]     = 2;
+    tree["b"] = 3;
+
+    radix_tree_stats stats = tree.stats();
+    ASSERT_EQ(0u, stats.layouts[0] + stats.layouts[1] + stats.layouts[2] + stats.layouts[3]);
+    // map nodes and the heap bytes of long labels and keys are counted
+    ASSERT_GE(stats.table_bytes, (stats.nodes - 1) * (sizeof(std::pair<const std::string, void*>) + 4 * sizeof(void*)));
+    ASSERT_GT(stats.key_bytes, 2 * 40u);
+    check_consistent(tree);
+}